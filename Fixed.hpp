@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>      // int8_t, int16_t, int32_t, int64_t, intmax_t
+#include <limits>       // numeric_limits
+#include <type_traits>  // enable_if, is_integral, make_unsigned
+
+/// Integer type with twice as many bits, for intermediate results.
+template <class Rep>
+struct FixedWide;
+template <>
+struct FixedWide<int8_t> {
+    using type = int16_t;
+};
+template <>
+struct FixedWide<int16_t> {
+    using type = int32_t;
+};
+template <>
+struct FixedWide<int32_t> {
+    using type = int64_t;
+};
+
+/// Integer square root, rounded to the nearest integer. Bit by bit, with
+/// only shifts, additions and comparisons, so it's cheap without an FPU or
+/// divider, and it can run at compile time.
+template <class U>
+constexpr U isqrt(U n) {
+    static_assert(std::is_unsigned<U>::value, "isqrt needs an unsigned type");
+    U root = 0, bit = U(U(1) << (8 * sizeof(U) - 2));
+    while (bit > n)
+        bit = U(bit >> 2);
+    while (bit != 0) {
+        if (n >= root + bit) {
+            n    = U(n - (root + bit));
+            root = U((root >> 1) + bit);
+        } else {
+            root = U(root >> 1);
+        }
+        bit = U(bit >> 2);
+    }
+    // n is now the remainder n - root², round up if it's more than root
+    return n > root ? U(root + 1) : root;
+}
+
+/**
+ * @brief   Signed fixed-point number in Q format: a `Rep` integer that counts
+ *          units of 2^-F.
+ *
+ * Meant for microcontrollers without an FPU, where it's several times faster
+ * than software floating point, and for constants and lookup tables that are
+ * computed at compile time: all operations are constexpr. Only uses the
+ * freestanding headers, so it can be included on its own.
+ *
+ * Arithmetic saturates: results that don't fit are clamped to min() or
+ * max() instead of wrapping around, and so are integers and doubles that
+ * are out of range. Products and quotients are rounded to the nearest
+ * representable value.
+ *
+ * Works as the element type of Array, TColVector, normsq and norm: sqrt is
+ * found by argument-dependent lookup.
+ *
+ * @tparam  F
+ *          Number of fractional bits.
+ * @tparam  Rep
+ *          Underlying signed integer type (int8_t, int16_t or int32_t).
+ */
+template <int F, class Rep = int32_t>
+class Fixed {
+    using Wide  = typename FixedWide<Rep>::type;
+    using UWide = std::make_unsigned_t<Wide>;
+    static_assert(F >= 0 && F < int(8 * sizeof(Rep)),
+                  "Invalid number of fractional bits");
+
+  public:
+    static constexpr int fraction_bits = F;
+    static constexpr Wide ONE          = Wide(1) << F;
+
+    constexpr Fixed() : raw(0) {}
+    template <class I, class = std::enable_if_t<std::is_integral<I>::value>>
+    constexpr Fixed(I i) : raw(fromInteger(i)) {}
+    /// Rounded to the nearest representable value.
+    constexpr explicit Fixed(double d) : raw(fromDouble(d)) {}
+
+    static constexpr Fixed fromRaw(Rep raw) {
+        Fixed f;
+        f.raw = raw;
+        return f;
+    }
+    constexpr Rep getRaw() const { return raw; }
+
+    static constexpr Fixed min() { return fromRaw(REP_MIN); }
+    static constexpr Fixed max() { return fromRaw(REP_MAX); }
+    /// Smallest positive value, 2^-F.
+    static constexpr Fixed epsilon() { return fromRaw(1); }
+
+    constexpr explicit operator double() const { return double(raw) / ONE; }
+    constexpr explicit operator float() const { return float(raw) / ONE; }
+
+    constexpr Fixed operator-() const { return fromRaw(saturate(-Wide(raw))); }
+    constexpr Fixed &operator+=(Fixed rhs) {
+        raw = saturate(Wide(raw) + rhs.raw);
+        return *this;
+    }
+    constexpr Fixed &operator-=(Fixed rhs) {
+        raw = saturate(Wide(raw) - rhs.raw);
+        return *this;
+    }
+    constexpr Fixed &operator*=(Fixed rhs) {
+        raw = saturate(roundShift(Wide(raw) * rhs.raw));
+        return *this;
+    }
+    /// Division by zero saturates to min() or max().
+    constexpr Fixed &operator/=(Fixed rhs) {
+        if (rhs.raw == 0) {
+            raw = raw < 0 ? REP_MIN : REP_MAX;
+            return *this;
+        }
+        Wide n = Wide(raw) * ONE, d = rhs.raw;
+        // Round half away from zero
+        Wide q = ((n < 0) == (d < 0) ? n + d / 2 : n - d / 2) / d;
+        raw    = saturate(q);
+        return *this;
+    }
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b) { return a += b; }
+    friend constexpr Fixed operator-(Fixed a, Fixed b) { return a -= b; }
+    friend constexpr Fixed operator*(Fixed a, Fixed b) { return a *= b; }
+    friend constexpr Fixed operator/(Fixed a, Fixed b) { return a /= b; }
+
+    friend constexpr bool operator==(Fixed a, Fixed b) {
+        return a.raw == b.raw;
+    }
+    friend constexpr bool operator!=(Fixed a, Fixed b) {
+        return a.raw != b.raw;
+    }
+    friend constexpr bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+    friend constexpr bool operator<=(Fixed a, Fixed b) {
+        return a.raw <= b.raw;
+    }
+    friend constexpr bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+    friend constexpr bool operator>=(Fixed a, Fixed b) {
+        return a.raw >= b.raw;
+    }
+
+    /// Square root, rounded to the nearest representable value. Negative
+    /// numbers give zero.
+    friend constexpr Fixed sqrt(Fixed f) {
+        if (f.raw <= 0)
+            return {};
+        // sqrt(raw · 2^-F) = sqrt(raw · 2^F) · 2^-F, which fits in UWide
+        return fromRaw(Rep(isqrt(UWide(UWide(f.raw) << F))));
+    }
+
+  private:
+    static constexpr Rep REP_MIN = std::numeric_limits<Rep>::min();
+    static constexpr Rep REP_MAX = std::numeric_limits<Rep>::max();
+    /// Range of the integer part, min() and max() rounded towards zero.
+    static constexpr Wide INTEGER_MIN = REP_MIN / ONE;
+    static constexpr Wide INTEGER_MAX = REP_MAX / ONE;
+
+    static constexpr Rep saturate(Wide w) {
+        return w < REP_MIN ? REP_MIN : w > REP_MAX ? REP_MAX : Rep(w);
+    }
+    /// Clamped before scaling: i · ONE could overflow Wide, and I can be
+    /// wider than Wide or unsigned.
+    template <class I>
+    static constexpr Rep fromInteger(I i) {
+        if (i > I(0))
+            return uintmax_t(i) > uintmax_t(INTEGER_MAX) ? REP_MAX
+                                                         : Rep(Wide(i) * ONE);
+        return intmax_t(i) < intmax_t(INTEGER_MIN) ? REP_MIN
+                                                   : Rep(Wide(i) * ONE);
+    }
+    /// Divide a product by 2^F, rounding half away from zero.
+    static constexpr Wide roundShift(Wide w) {
+        if constexpr (F == 0) {
+            return w;
+        } else {
+            Wide half = Wide(1) << (F - 1);
+            return w >= 0 ? (w + half) >> F : -((-w + half) >> F);
+        }
+    }
+    static constexpr Rep fromDouble(double d) {
+        double scaled = d * ONE;
+        if (scaled >= double(REP_MAX))
+            return REP_MAX;
+        if (scaled <= double(REP_MIN))
+            return REP_MIN;
+        return Rep(scaled >= 0 ? scaled + 0.5 : scaled - 0.5);
+    }
+
+    Rep raw;
+};
+
+/// ±32768 with a resolution of 1.5e-5.
+using Q16_16 = Fixed<16, int32_t>;
+/// ±8388608 with a resolution of 0.004, e.g. for squared distances.
+using Q24_8 = Fixed<8, int32_t>;
+/// ±128 with a resolution of 0.004, fast on 8-bit microcontrollers.
+using Q8_8 = Fixed<8, int16_t>;
@@ -1,8 +1,256 @@
-#include <cmath>        // sqrt
-#include <cstddef>      // size_t
-#include <iostream>     // ostream, cout, endl
-#include <numeric>      // accumulate
-#include <type_traits>  // enable_if
+#include "Fixed.hpp"  // Fixed, Q16_16, Q24_8
+
+#include <algorithm>           // min, find, nth_element, push_heap
+#include <atomic>              // atomic
+#include <cmath>               // sqrt
+#include <condition_variable>  // condition_variable
+#include <cstddef>             // size_t
+#include <cstdint>             // uint8_t, uint32_t, int64_t
+#include <deque>               // deque
+#include <exception>           // exception_ptr, rethrow_exception
+#include <functional>          // plus, minus, function
+#include <initializer_list>    // initializer_list
+#include <iostream>            // ostream, cout, endl
+#include <limits>              // numeric_limits
+#include <memory>              // unique_ptr, make_unique
+#include <mutex>               // mutex, lock_guard, unique_lock
+#include <new>                 // align_val_t
+#include <numeric>             // accumulate, iota
+#include <thread>              // thread
+#include <type_traits>         // enable_if
+#include <utility>             // forward, move, index_sequence
+#include <vector>              // vector
+
+#ifndef ARRAY_NO_SIMD
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+#endif
+
+/// True during constant evaluation, where the SIMD kernels can't be used.
+constexpr bool isConstantEvaluated() {
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+    return __builtin_is_constant_evaluated();
+#else
+    return false;
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+    return __builtin_is_constant_evaluated();
+#else
+    return false;  // GCC 8: float and double arrays are not constexpr-capable
+#endif
+}
+
+//============================================================================//
+
+/// Kernels over contiguous elements. The SIMD versions are selected at compile
+/// time, define ARRAY_NO_SIMD to always use the scalar ones.
+namespace kernels {
+
+/// Reference implementations, used for small arrays, for types without SIMD
+/// kernels, and for exact-result checks.
+namespace scalar {
+template <class T>
+constexpr void sub(T *dst, const T *a, const T *b, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = a[i] - b[i];
+}
+template <class T>
+constexpr T dot(const T *a, const T *b, size_t n) {
+    T sum = {};
+    for (size_t i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+}  // namespace scalar
+
+/// SIMD kernels for T, `width` is the number of elements per register (1 if
+/// there are no kernels for T). Subtraction gives exactly the same results as
+/// the scalar kernel, the dot product sums in a different order.
+template <class T>
+struct Simd {
+    static constexpr size_t width = 1;
+};
+
+#ifndef ARRAY_NO_SIMD
+#if defined(__AVX__)
+template <>
+struct Simd<float> {
+    static constexpr size_t width = 8;
+    static void sub(float *dst, const float *a, const float *b, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_sub_ps(_mm256_loadu_ps(a + i),
+                                                    _mm256_loadu_ps(b + i)));
+        scalar::sub(dst + i, a + i, b + i, n - i);
+    }
+    static float dot(const float *a, const float *b, size_t n) {
+        __m256 acc = _mm256_setzero_ps();
+        size_t i   = 0;
+        for (; i + 8 <= n; i += 8)
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+                                                   _mm256_loadu_ps(b + i)));
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, acc);
+        float sum = scalar::dot(a + i, b + i, n - i);
+        for (float l : lanes)
+            sum += l;
+        return sum;
+    }
+};
+template <>
+struct Simd<double> {
+    static constexpr size_t width = 4;
+    static void sub(double *dst, const double *a, const double *b, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(dst + i, _mm256_sub_pd(_mm256_loadu_pd(a + i),
+                                                    _mm256_loadu_pd(b + i)));
+        scalar::sub(dst + i, a + i, b + i, n - i);
+    }
+    static double dot(const double *a, const double *b, size_t n) {
+        __m256d acc = _mm256_setzero_pd();
+        size_t i    = 0;
+        for (; i + 4 <= n; i += 4)
+            acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+                                                   _mm256_loadu_pd(b + i)));
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, acc);
+        double sum = scalar::dot(a + i, b + i, n - i);
+        for (double l : lanes)
+            sum += l;
+        return sum;
+    }
+};
+#elif defined(__SSE2__)
+template <>
+struct Simd<float> {
+    static constexpr size_t width = 4;
+    static void sub(float *dst, const float *a, const float *b, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i,
+                          _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        scalar::sub(dst + i, a + i, b + i, n - i);
+    }
+    static float dot(const float *a, const float *b, size_t n) {
+        __m128 acc = _mm_setzero_ps();
+        size_t i   = 0;
+        for (; i + 4 <= n; i += 4)
+            acc = _mm_add_ps(
+                acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, acc);
+        float sum = scalar::dot(a + i, b + i, n - i);
+        for (float l : lanes)
+            sum += l;
+        return sum;
+    }
+};
+template <>
+struct Simd<double> {
+    static constexpr size_t width = 2;
+    static void sub(double *dst, const double *a, const double *b, size_t n) {
+        size_t i = 0;
+        for (; i + 2 <= n; i += 2)
+            _mm_storeu_pd(dst + i,
+                          _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        scalar::sub(dst + i, a + i, b + i, n - i);
+    }
+    static double dot(const double *a, const double *b, size_t n) {
+        __m128d acc = _mm_setzero_pd();
+        size_t i    = 0;
+        for (; i + 2 <= n; i += 2)
+            acc = _mm_add_pd(
+                acc, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        alignas(16) double lanes[2];
+        _mm_store_pd(lanes, acc);
+        return scalar::dot(a + i, b + i, n - i) + lanes[0] + lanes[1];
+    }
+};
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+// ARMv7 NEON has no double precision, doubles use the scalar kernels (VFP).
+template <>
+struct Simd<float> {
+    static constexpr size_t width = 4;
+    static void sub(float *dst, const float *a, const float *b, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            vst1q_f32(dst + i, vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+        scalar::sub(dst + i, a + i, b + i, n - i);
+    }
+    static float dot(const float *a, const float *b, size_t n) {
+        float32x4_t acc = vdupq_n_f32(0);
+        size_t i        = 0;
+        for (; i + 4 <= n; i += 4)  // vmla rounds like vmul + vadd, not fused
+            acc = vaddq_f32(acc, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+        float lanes[4];
+        vst1q_f32(lanes, acc);
+        float sum = scalar::dot(a + i, b + i, n - i);
+        for (float l : lanes)
+            sum += l;
+        return sum;
+    }
+};
+#endif
+#endif  // ARRAY_NO_SIMD
+
+/// Use the SIMD kernels for n elements of type T? Arrays shorter than a
+/// single register (like the 2D points below) use the scalar kernels, so
+/// their results don't change.
+template <class T>
+constexpr bool useSimd(size_t n) {
+    return Simd<T>::width > 1 && n >= Simd<T>::width && !isConstantEvaluated();
+}
+
+template <class T>
+constexpr void sub(T *dst, const T *a, const T *b, size_t n) {
+    if constexpr (Simd<T>::width > 1)
+        if (useSimd<T>(n))
+            return Simd<T>::sub(dst, a, b, n);
+    scalar::sub(dst, a, b, n);
+}
+
+template <class T>
+constexpr T dot(const T *a, const T *b, size_t n) {
+    if constexpr (Simd<T>::width > 1)
+        if (useSimd<T>(n))
+            return Simd<T>::dot(a, b, n);
+    return scalar::dot(a, b, n);
+}
+
+}  // namespace kernels
+
+//============================================================================//
+
+template <class T, size_t N>
+struct Array;
+
+template <class T>
+struct IsArray : std::false_type {};
+template <class T, size_t N>
+struct IsArray<Array<T, N>> : std::true_type {};
+
+/// Tag of the lazy matrix expressions, see MatrixExpression.
+struct MatrixExpressionBase {};
+template <class T>
+using IsMatrixExpression = std::is_base_of<MatrixExpressionBase, T>;
+
+/// The scalar type of (nested) arrays, e.g. float for TColVector<float, R>,
+/// and the total number of scalars.
+template <class T>
+struct Flat {
+    using type                   = T;
+    static constexpr size_t size = 1;
+};
+template <class T, size_t N>
+struct Flat<Array<T, N>> {
+    using type                   = typename Flat<T>::type;
+    static constexpr size_t size = N * Flat<T>::size;
+};
 
 template <class T, size_t N>
 struct Array {
@@ -18,20 +266,65 @@ struct Array {
     constexpr T *end() { return &data[N]; }
     constexpr const T *end() const { return &data[N]; }
 
-    /// Subtract
-    constexpr Array<T, N> operator-(const Array<T, N> &rhs) const {
+    /// Subtract. Matrices (nested arrays) use the lazy operator- below.
+    template <class U = T>
+    constexpr std::enable_if_t<!IsArray<U>::value, Array<T, N>>
+    operator-(const Array<T, N> &rhs) const {
         Array<T, N> result = *this;
         result -= rhs;
         return result;
     }
 
+    /// Evaluate a matrix expression, without temporaries unless the
+    /// expression is a product that reads this matrix.
+    template <class E,
+              class = std::enable_if_t<IsMatrixExpression<E>::value>>
+    constexpr Array<T, N> &operator=(const E &expression) {
+        assignMatrix(*this, expression);
+        return *this;
+    }
+
+    /// Add
+    constexpr Array<T, N> &operator+=(const Array<T, N> &rhs) {
+        for (size_t i = 0; i < N; ++i)
+            (*this)[i] += rhs[i];
+        return *this;
+    }
+
+    /// Multiply by a scalar
+    constexpr Array<T, N> &operator*=(const typename Flat<T>::type &s) {
+        for (size_t i = 0; i < N; ++i)
+            (*this)[i] *= s;
+        return *this;
+    }
+
     /// Subtract
     constexpr Array<T, N> &operator-=(const Array<T, N> &rhs) {
+        if constexpr (kernels::Simd<scalar_type>::width > 1)
+            if (kernels::useSimd<scalar_type>(flat_size)) {
+                kernels::sub(flat(), flat(), rhs.flat(), flat_size);
+                return *this;
+            }
         for (size_t i = 0; i < N; ++i)
             (*this)[i] -= rhs[i];
         return *this;
     }
 
+    /// Scalars of nested arrays, e.g. the floats of a TMatrix<float, R, C>.
+    using scalar_type                 = typename Flat<Array>::type;
+    static constexpr size_t flat_size = Flat<Array>::size;
+
+    /// All scalars of (nested) arrays as a single contiguous range, for the
+    /// kernels. Nested arrays have no padding, so the scalars are contiguous.
+    scalar_type *flat() {
+        static_assert(sizeof(Array) == flat_size * sizeof(scalar_type));
+        return reinterpret_cast<scalar_type *>(this);
+    }
+    const scalar_type *flat() const {
+        static_assert(sizeof(Array) == flat_size * sizeof(scalar_type));
+        return reinterpret_cast<const scalar_type *>(this);
+    }
+
     /// Implicit conversion from Array<T, 1> to T&.
     template <bool EnableBool = true>
     constexpr operator typename std::add_lvalue_reference<
@@ -78,9 +371,13 @@ template <class T, class U, size_t R>
 constexpr auto operator*(const TColVector<T, R> &lhs,
                          const TColVector<U, R> &rhs) {
     using sum_t = std::remove_reference_t<decltype(lhs[0][0] * rhs[0][0])>;
-    sum_t sum   = {};
+    if constexpr (std::is_same<T, U>::value &&
+                  kernels::Simd<T>::width > 1)
+        if (kernels::useSimd<T>(R))
+            return sum_t(kernels::dot(lhs.flat(), rhs.flat(), R));
+    sum_t sum = {};
     for (size_t i = 0; i < R; ++i)
-        sum += lhs[i] * rhs[i];
+        sum += lhs[i][0] * rhs[i][0];
     return sum;
 }
 
@@ -88,6 +385,9 @@ constexpr auto operator*(const TColVector<T, R> &lhs,
 template <class T, size_t C>
 constexpr auto normsq(const TColVector<T, C> &colvector)
     -> decltype(colvector[0] * colvector[0]) {
+    if constexpr (kernels::Simd<T>::width > 1)
+        if (kernels::useSimd<T>(C))
+            return {kernels::dot(colvector.flat(), colvector.flat(), C)};
     decltype(colvector[0] * colvector[0]) sumsq = {};
     for (size_t c = 0; c < C; ++c)
         sumsq += colvector[c] * colvector[c];
@@ -103,6 +403,296 @@ constexpr auto norm(const TColVector<T, C> &colvector)
 
 //============================================================================//
 
+// Lazy expressions over matrices: `a - b`, `a + b` and `A * B` don't compute
+// anything, they return a small object that computes a single element on
+// demand. A chain like `normsq(a - b)` or `x = A * x - b` is evaluated in a
+// single loop, without any intermediate matrices.
+//
+// Operands that are lvalues are referenced, temporaries are moved into the
+// expression, so expressions can be stored with `auto`.
+
+template <class M>
+struct MatrixLeaf;
+template <class E>
+struct IsMatrixLeaf : std::false_type {};
+template <class M>
+struct IsMatrixLeaf<MatrixLeaf<M>> : std::true_type {};
+
+/// Number of rows, columns and the scalar type of matrices and expressions.
+template <class M, class = void>
+struct MatrixShape {
+    static constexpr bool valid = false;
+};
+template <class T, size_t R, size_t C>
+struct MatrixShape<TMatrix<T, R, C>, std::enable_if_t<!IsArray<T>::value>> {
+    static constexpr bool valid = true;
+    using scalar_type           = T;
+    static constexpr size_t rows = R, cols = C;
+};
+template <class E>
+struct MatrixShape<E, std::enable_if_t<IsMatrixExpression<E>::value>> {
+    static constexpr bool valid = true;
+    using scalar_type           = typename E::scalar_type;
+    static constexpr size_t rows = E::rows, cols = E::cols;
+};
+
+template <class M>
+constexpr bool isMatrix = MatrixShape<std::decay_t<M>>::valid;
+
+/// Base of all expressions (CRTP), so they can be converted to a matrix.
+template <class E>
+struct MatrixExpression : MatrixExpressionBase {
+    template <class T, size_t R, size_t C>
+    constexpr operator TMatrix<T, R, C>() const {
+        static_assert(R == E::rows && C == E::cols, "Size mismatch");
+        TMatrix<T, R, C> result = {};
+        assignMatrix(result, static_cast<const E &>(*this));
+        return result;
+    }
+};
+
+/// Matrix operand of an expression, `const TMatrix &` or TMatrix.
+template <class M>
+struct MatrixLeaf : MatrixExpression<MatrixLeaf<M>> {
+    using shape                  = MatrixShape<std::decay_t<M>>;
+    using scalar_type            = typename shape::scalar_type;
+    static constexpr size_t rows = shape::rows, cols = shape::cols;
+    static constexpr bool elementwise = true;
+
+    template <class U>
+    constexpr explicit MatrixLeaf(U &&u) : matrix(std::forward<U>(u)) {}
+
+    constexpr scalar_type operator()(size_t r, size_t c) const {
+        return matrix[r][c];
+    }
+    constexpr bool refersTo(const void *p) const {
+        return std::is_reference<M>::value && p == &matrix;
+    }
+
+    M matrix;
+};
+
+/// How an operand is stored in an expression: nested expressions by value,
+/// matrices by reference if they're lvalues, by value if they're temporaries.
+template <class X>
+using MatrixOperand = std::conditional_t<
+    IsMatrixExpression<std::decay_t<X>>::value, std::decay_t<X>,
+    MatrixLeaf<std::conditional_t<std::is_lvalue_reference<X>::value,
+                                  const std::decay_t<X> &, std::decay_t<X>>>>;
+
+template <class X>
+constexpr MatrixOperand<X> matrixOperand(X &&x) {
+    return MatrixOperand<X>(std::forward<X>(x));
+}
+
+/// Element-wise operation on two matrices of the same size.
+template <class L, class R, class Op>
+struct MatrixElementwise : MatrixExpression<MatrixElementwise<L, R, Op>> {
+    static_assert(L::rows == R::rows && L::cols == R::cols, "Size mismatch");
+    using scalar_type = std::decay_t<decltype(
+        Op{}(std::declval<typename L::scalar_type>(),
+             std::declval<typename R::scalar_type>()))>;
+    static constexpr size_t rows = L::rows, cols = L::cols;
+    static constexpr bool elementwise = L::elementwise && R::elementwise;
+
+    constexpr MatrixElementwise(L l, R r) : l(std::move(l)), r(std::move(r)) {}
+
+    constexpr scalar_type operator()(size_t i, size_t j) const {
+        return Op{}(l(i, j), r(i, j));
+    }
+    constexpr bool refersTo(const void *p) const {
+        return l.refersTo(p) || r.refersTo(p);
+    }
+
+    L l;
+    R r;
+};
+
+/// Inner products up to this length are unrolled at compile time.
+constexpr size_t MATRIX_UNROLL_LIMIT = 16;
+/// Products of matrices larger than this (in bytes) are evaluated in blocks
+/// that fit in the L1 cache.
+constexpr size_t MATRIX_BLOCKING_SIZE = 16 * 1024;
+/// Rows and columns per block.
+constexpr size_t MATRIX_BLOCK = 32;
+
+/// Matrix product. Operands that are expressions themselves are evaluated
+/// once, instead of once for every element of the product.
+template <class L, class R>
+struct MatrixProduct : MatrixExpression<MatrixProduct<L, R>> {
+    static_assert(L::cols == R::rows, "Size mismatch");
+    using scalar_type = std::decay_t<decltype(
+        std::declval<typename L::scalar_type>() *
+        std::declval<typename R::scalar_type>())>;
+    static constexpr size_t rows = L::rows, cols = R::cols, inner = L::cols;
+    static constexpr bool elementwise = false;
+
+    template <class E>
+    using Operand = std::conditional_t<
+        IsMatrixLeaf<E>::value, E,
+        MatrixLeaf<TMatrix<typename E::scalar_type, E::rows, E::cols>>>;
+
+    constexpr MatrixProduct(L l, R r)
+        : l(evaluateOperand(std::move(l))), r(evaluateOperand(std::move(r))) {}
+
+    constexpr scalar_type operator()(size_t i, size_t j) const {
+        if constexpr (inner <= MATRIX_UNROLL_LIMIT)
+            return dot(i, j, std::make_index_sequence<inner>());
+        scalar_type sum = {};
+        for (size_t k = 0; k < inner; ++k)
+            sum += l(i, k) * r(k, j);
+        return sum;
+    }
+    constexpr bool refersTo(const void *p) const {
+        return l.refersTo(p) || r.refersTo(p);
+    }
+
+    template <size_t... K>
+    constexpr scalar_type dot(size_t i, size_t j,
+                              std::index_sequence<K...>) const {
+        return (... + (l(i, K) * r(K, j)));
+    }
+
+    template <class E>
+    static constexpr Operand<E> evaluateOperand(E &&e) {
+        if constexpr (IsMatrixLeaf<E>::value)
+            return std::move(e);
+        else
+            return Operand<E>(
+                TMatrix<typename E::scalar_type, E::rows, E::cols>(e));
+    }
+
+    Operand<L> l;
+    Operand<R> r;
+};
+
+template <class L, class R, class Op>
+constexpr auto matrixElementwise(L &&l, R &&r, Op) {
+    using E = MatrixElementwise<MatrixOperand<L>, MatrixOperand<R>, Op>;
+    return E(matrixOperand(std::forward<L>(l)),
+             matrixOperand(std::forward<R>(r)));
+}
+
+template <class L, class R,
+          class = std::enable_if_t<isMatrix<L> && isMatrix<R>>>
+constexpr auto operator+(L &&l, R &&r) {
+    return matrixElementwise(std::forward<L>(l), std::forward<R>(r),
+                             std::plus<>());
+}
+
+template <class L, class R,
+          class = std::enable_if_t<isMatrix<L> && isMatrix<R>>>
+constexpr auto operator-(L &&l, R &&r) {
+    return matrixElementwise(std::forward<L>(l), std::forward<R>(r),
+                             std::minus<>());
+}
+
+/// Matrix product. The product of two column vectors of the same length is
+/// the inner product above.
+template <class L, class R,
+          class = std::enable_if_t<
+              isMatrix<L> && isMatrix<R> &&
+              !(MatrixShape<std::decay_t<L>>::cols == 1 &&
+                MatrixShape<std::decay_t<R>>::cols == 1 &&
+                !IsMatrixExpression<std::decay_t<L>>::value &&
+                !IsMatrixExpression<std::decay_t<R>>::value)>>
+constexpr auto operator*(L &&l, R &&r) {
+    using E = MatrixProduct<MatrixOperand<L>, MatrixOperand<R>>;
+    return E(matrixOperand(std::forward<L>(l)),
+             matrixOperand(std::forward<R>(r)));
+}
+
+/// Evaluate an expression into a matrix. Products that read the destination
+/// are evaluated into a temporary first.
+template <class T, size_t R, size_t C, class E>
+constexpr void assignMatrix(TMatrix<T, R, C> &dst, const E &e) {
+    static_assert(R == E::rows && C == E::cols, "Size mismatch");
+    if (!E::elementwise && e.refersTo(&dst)) {
+        TMatrix<T, R, C> tmp = {};
+        assignMatrix(tmp, e);
+        dst = tmp;
+    } else {
+        for (size_t i = 0; i < R; ++i)
+            for (size_t j = 0; j < C; ++j)
+                dst[i][j] = e(i, j);
+    }
+}
+
+/// Evaluate a large product in blocks, so the rows of the left operand and
+/// the columns of the right one that are being combined stay in the cache.
+/// Every element is summed in the same order as an unblocked product.
+template <class T, size_t R, size_t C, class L, class Rhs>
+void multiplyBlocked(TMatrix<T, R, C> &dst, const L &l, const Rhs &r) {
+    constexpr size_t K = L::cols, B = MATRIX_BLOCK;
+    for (size_t i = 0; i < R; ++i)
+        for (size_t j = 0; j < C; ++j)
+            dst[i][j] = T{};
+    for (size_t ii = 0; ii < R; ii += B)
+        for (size_t kk = 0; kk < K; kk += B)
+            for (size_t jj = 0; jj < C; jj += B)
+                for (size_t i = ii; i < std::min(ii + B, R); ++i)
+                    for (size_t k = kk; k < std::min(kk + B, K); ++k) {
+                        T a = l(i, k);
+                        for (size_t j = jj; j < std::min(jj + B, C); ++j)
+                            dst[i][j] += a * r(k, j);
+                    }
+}
+
+template <class T, size_t R, size_t C, class L, class Rhs>
+constexpr void assignMatrix(TMatrix<T, R, C> &dst,
+                            const MatrixProduct<L, Rhs> &e) {
+    using E = MatrixProduct<L, Rhs>;
+    static_assert(R == E::rows && C == E::cols, "Size mismatch");
+    constexpr size_t bytes =
+        (R * E::inner + E::inner * C + R * C) * sizeof(T);
+    if (e.refersTo(&dst)) {
+        TMatrix<T, R, C> tmp = {};
+        assignMatrix(tmp, e);
+        dst = tmp;
+    } else if (bytes > MATRIX_BLOCKING_SIZE && !isConstantEvaluated()) {
+        multiplyBlocked(dst, e.l, e.r);
+    } else {
+        for (size_t i = 0; i < R; ++i)
+            for (size_t j = 0; j < C; ++j)
+                dst[i][j] = e(i, j);
+    }
+}
+
+/// Evaluate an expression into a matrix.
+template <class E, class = std::enable_if_t<IsMatrixExpression<E>::value>>
+constexpr auto evaluate(const E &e) {
+    return TMatrix<typename E::scalar_type, E::rows, E::cols>(e);
+}
+
+/// Norm squared of a column vector expression, in a single loop.
+template <class E, class = std::enable_if_t<IsMatrixExpression<E>::value>>
+constexpr Array<typename E::scalar_type, 1> normsq(const E &e) {
+    static_assert(E::cols == 1, "normsq requires a column vector");
+    typename E::scalar_type sumsq = {};
+    for (size_t r = 0; r < E::rows; ++r) {
+        auto v = e(r, 0);
+        sumsq += v * v;
+    }
+    return {sumsq};
+}
+
+/// Norm of a column vector expression.
+template <class E, class = std::enable_if_t<IsMatrixExpression<E>::value>>
+constexpr auto norm(const E &e) {
+    using std::sqrt;
+    return sqrt(typename E::scalar_type(normsq(e)));
+}
+
+//============================================================================//
+
+/// Fixed-point numbers print like doubles.
+template <int F, class Rep>
+std::ostream &operator<<(std::ostream &os, Fixed<F, Rep> f) {
+    return os << double(f);
+}
+
+//============================================================================//
+
 #define REFERENCE
 
 struct Point;
@@ -142,7 +732,7 @@ struct Point {
     static float distanceSquared(Point a, Point b) {
         using namespace std;
         // cout << "a = " << a << ", b = " << b << endl;
-        auto diff = a.vec() - b.vec();
+        auto diff = a.vec() - b.vec();  // Lazy, evaluated by normsq
         // cout << "diff = " << Point(diff) << endl;
         auto result = normsq(diff);
         // cout << "normsq(diff) = " << result << endl;
@@ -154,16 +744,978 @@ inline std::ostream &operator<<(std::ostream &os, Point p) {
     return os << '(' << p.x << ", " << p.y << ')';
 }
 
+//============================================================================//
+
+/// Kernels over the coordinates of many points, see PointCloud.
+namespace kernels {
+
+namespace scalar {
+/// Squared distances from (px, py) to the points (x[i], y[i]), computed in
+/// the same order as Point::distanceSquared.
+inline void distancesSquared(const float *x, const float *y, float px,
+                             float py, float *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        float dx = px - x[i], dy = py - y[i];
+        out[i]   = dx * dx + dy * dy;
+    }
+}
+inline void squareRoots(float *data, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        data[i] = std::sqrt(data[i]);
+}
+inline float minimum(const float *data, size_t n) {
+    float result = INFINITY;
+    for (size_t i = 0; i < n; ++i)
+        result = data[i] < result ? data[i] : result;
+    return result;
+}
+}  // namespace scalar
+
+#if !defined(ARRAY_NO_SIMD) && defined(__AVX__)
+inline void distancesSquared(const float *x, const float *y, float px,
+                             float py, float *out, size_t n) {
+    __m256 vx = _mm256_set1_ps(px), vy = _mm256_set1_ps(py);
+    size_t i  = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 dx = _mm256_sub_ps(vx, _mm256_loadu_ps(x + i));
+        __m256 dy = _mm256_sub_ps(vy, _mm256_loadu_ps(y + i));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(dx, dx),
+                                                _mm256_mul_ps(dy, dy)));
+    }
+    scalar::distancesSquared(x + i, y + i, px, py, out + i, n - i);
+}
+inline void squareRoots(float *data, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(data + i, _mm256_sqrt_ps(_mm256_loadu_ps(data + i)));
+    scalar::squareRoots(data + i, n - i);
+}
+inline float minimum(const float *data, size_t n) {
+    __m256 acc = _mm256_set1_ps(INFINITY);
+    size_t i   = 0;
+    for (; i + 8 <= n; i += 8)
+        acc = _mm256_min_ps(acc, _mm256_loadu_ps(data + i));
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, acc);
+    return std::min(scalar::minimum(lanes, 8),
+                    scalar::minimum(data + i, n - i));
+}
+#elif !defined(ARRAY_NO_SIMD) && defined(__SSE2__)
+inline void distancesSquared(const float *x, const float *y, float px,
+                             float py, float *out, size_t n) {
+    __m128 vx = _mm_set1_ps(px), vy = _mm_set1_ps(py);
+    size_t i  = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 dx = _mm_sub_ps(vx, _mm_loadu_ps(x + i));
+        __m128 dy = _mm_sub_ps(vy, _mm_loadu_ps(y + i));
+        _mm_storeu_ps(out + i,
+                      _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+    }
+    scalar::distancesSquared(x + i, y + i, px, py, out + i, n - i);
+}
+inline void squareRoots(float *data, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(data + i, _mm_sqrt_ps(_mm_loadu_ps(data + i)));
+    scalar::squareRoots(data + i, n - i);
+}
+inline float minimum(const float *data, size_t n) {
+    __m128 acc = _mm_set1_ps(INFINITY);
+    size_t i   = 0;
+    for (; i + 4 <= n; i += 4)
+        acc = _mm_min_ps(acc, _mm_loadu_ps(data + i));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, acc);
+    return std::min(scalar::minimum(lanes, 4),
+                    scalar::minimum(data + i, n - i));
+}
+#elif !defined(ARRAY_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+inline void distancesSquared(const float *x, const float *y, float px,
+                             float py, float *out, size_t n) {
+    float32x4_t vx = vdupq_n_f32(px), vy = vdupq_n_f32(py);
+    size_t i       = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t dx = vsubq_f32(vx, vld1q_f32(x + i));
+        float32x4_t dy = vsubq_f32(vy, vld1q_f32(y + i));
+        vst1q_f32(out + i, vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)));
+    }
+    scalar::distancesSquared(x + i, y + i, px, py, out + i, n - i);
+}
+// ARMv7 NEON only has a reciprocal square root estimate, which is not
+// correctly rounded, so use the VFP square root instead.
+inline void squareRoots(float *data, size_t n) {
+    scalar::squareRoots(data, n);
+}
+inline float minimum(const float *data, size_t n) {
+    float32x4_t acc = vdupq_n_f32(INFINITY);
+    size_t i        = 0;
+    for (; i + 4 <= n; i += 4)
+        acc = vminq_f32(acc, vld1q_f32(data + i));
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+    return std::min(scalar::minimum(lanes, 4),
+                    scalar::minimum(data + i, n - i));
+}
+#else
+using scalar::distancesSquared;
+using scalar::minimum;
+using scalar::squareRoots;
+#endif
+
+}  // namespace kernels
+
+/// Allocator for arrays that start on a boundary of `Align` bytes, e.g. a
+/// cache line, so SIMD loads never straddle one.
+template <class T, size_t Align>
+struct AlignedAllocator {
+    using value_type = T;
+    template <class U>
+    struct rebind {
+        using other = AlignedAllocator<U, Align>;
+    };
+
+    AlignedAllocator() = default;
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U, Align> &) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(
+            ::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T *p, size_t) {
+        ::operator delete(p, std::align_val_t(Align));
+    }
+    bool operator==(const AlignedAllocator &) const { return true; }
+    bool operator!=(const AlignedAllocator &) const { return false; }
+};
+
+/**
+ * @brief   Structure-of-arrays storage of many points: all x coordinates in
+ *          one contiguous array, all y coordinates in another.
+ *
+ * The batch operations run over the contiguous coordinates with the SIMD
+ * kernels above, instead of one Point::distance call per pair.
+ *
+ * Tolerance: the kernels compute `dx * dx + dy * dy` and the square root in
+ * the same order and with the same (correctly rounded) operations as
+ * Point::distance, so the results are identical, unless the compiler
+ * contracts the scalar version into a fused multiply-add
+ * (`-ffp-contract=fast` with FMA). The results then differ by at most 1 ulp
+ * from Point::distance.
+ */
+class PointCloud {
+  public:
+    using Coordinates = std::vector<float, AlignedAllocator<float, 64>>;
+
+    PointCloud() = default;
+    PointCloud(std::initializer_list<Point> points) {
+        reserve(points.size());
+        for (Point p : points)
+            push_back(p);
+    }
+
+    size_t size() const { return xs.size(); }
+    bool empty() const { return xs.empty(); }
+    void reserve(size_t n) {
+        xs.reserve(n);
+        ys.reserve(n);
+    }
+    void clear() {
+        xs.clear();
+        ys.clear();
+    }
+    void push_back(Point p) {
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+    }
+    Point operator[](size_t i) const { return {xs[i], ys[i]}; }
+
+    const float *x() const { return xs.data(); }
+    const float *y() const { return ys.data(); }
+    float *x() { return xs.data(); }
+    float *y() { return ys.data(); }
+
+    /// Squared distances from p to every point, `out` has size() elements.
+    void distancesSquared(Point p, float *out) const {
+        kernels::distancesSquared(x(), y(), p.x, p.y, out, size());
+    }
+
+    /// Distances from p to every point, `out` has size() elements.
+    void distances(Point p, float *out) const {
+        distancesSquared(p, out);
+        kernels::squareRoots(out, size());
+    }
+
+    /// Distances between every point of this cloud (rows) and every point
+    /// of the other one (columns). `out` has size() × other.size() elements,
+    /// row-major.
+    void pairwiseDistances(const PointCloud &other, float *out) const {
+        for (size_t i = 0; i < size(); ++i)
+            other.distances((*this)[i], out + i * other.size());
+    }
+
+    /// Set `mask[i]` to 1 if point i lies within `radius` of p (inclusive),
+    /// to 0 otherwise, comparing squared distances. Returns the number of
+    /// points within the radius.
+    size_t withinRadius(Point p, float radius, uint8_t *mask) const {
+        constexpr size_t CHUNK = 256;
+        float d2[CHUNK];
+        float r2     = radius * radius;
+        size_t count = 0;
+        for (size_t i = 0; i < size(); i += CHUNK) {
+            size_t n = std::min(CHUNK, size() - i);
+            kernels::distancesSquared(x() + i, y() + i, p.x, p.y, d2, n);
+            for (size_t k = 0; k < n; ++k) {
+                mask[i + k] = d2[k] <= r2;
+                count += mask[i + k];
+            }
+        }
+        return count;
+    }
+
+  private:
+    Coordinates xs, ys;
+};
+
+//============================================================================//
+
+/**
+ * @brief   Two-dimensional k-d tree over a set of points, for k-nearest and
+ *          radius queries in O(log N) per query instead of O(N).
+ *
+ * build() creates a balanced tree from all points at once (O(N log N)),
+ * insert() adds a single point. Inserting many points in an unfortunate order
+ * can make the tree deep, so it is rebuilt once it is more than twice as deep
+ * as a balanced tree.
+ *
+ * Subtrees are skipped when the squared distance to their splitting line is
+ * larger than the current candidate, so the distances themselves are only
+ * computed (with Point::distanceSquared) for a few points.
+ */
+class KdTree {
+  public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Neighbour {
+        uint32_t index;         ///< Index of the point, in insertion order
+        float distanceSquared;  ///< Squared distance to the query point
+    };
+
+    KdTree() = default;
+    explicit KdTree(std::vector<Point> points) { build(std::move(points)); }
+
+    /// Replace all points and build a balanced tree.
+    void build(std::vector<Point> points) {
+        this->points = std::move(points);
+        rebuild();
+    }
+
+    /// Add a single point, returns its index. Subtrees that get out of
+    /// balance are rebuilt (like a scapegoat tree), so inserting points in
+    /// order takes O(log² n) amortized time per point.
+    uint32_t insert(Point p) {
+        uint32_t index = uint32_t(points.size());
+        points.push_back(p);
+        nodes.push_back({index, NONE, NONE, 0, 1});
+        if (root == NONE) {
+            root = index;
+            return index;
+        }
+        path.clear();
+        uint32_t node = root;
+        while (true) {
+            path.push_back(node);
+            Node &n = nodes[node];
+            ++n.count;
+            uint32_t &child = coordinate(p, n.axis) <
+                                      coordinate(points[n.index], n.axis)
+                                  ? n.left
+                                  : n.right;
+            if (child == NONE) {
+                child             = index;
+                nodes[index].axis = n.axis ^ 1;
+                break;
+            }
+            node = child;
+        }
+        // Rebuild the largest subtree on the path that is out of balance
+        for (size_t i = 0; i < path.size(); ++i) {
+            if (unbalanced(nodes[path[i]])) {
+                rebuild(i > 0 ? path[i - 1] : NONE, path[i]);
+                break;
+            }
+        }
+        return index;
+    }
+
+    size_t size() const { return points.size(); }
+    Point operator[](size_t index) const { return points[index]; }
+
+    /**
+     * @brief   Find the k points closest to q.
+     *
+     * @param   out
+     *          Receives min(k, size()) neighbours, closest first.
+     */
+    void nearest(Point q, size_t k, std::vector<Neighbour> &out) const {
+        out.clear();
+        if (k == 0)
+            return;
+        out.reserve(k);
+        nearest(root, q, k, out);
+        std::sort_heap(out.begin(), out.end(), closer);
+    }
+
+    /// Find all points within a radius of q (inclusive), in no particular
+    /// order.
+    void radius(Point q, float radius, std::vector<Neighbour> &out) const {
+        out.clear();
+        withinRadius(root, q, radius * radius, out);
+    }
+
+    /**
+     * @brief   Find the k nearest neighbours of many points at once.
+     *
+     * @param   out
+     *          Receives k neighbours per query, closest first. If the tree
+     *          has fewer than k points, the rest have index NONE.
+     */
+    void nearest(const std::vector<Point> &queries, size_t k,
+                 std::vector<Neighbour> &out) const {
+        out.assign(queries.size() * k, {NONE, INFINITY});
+        std::vector<Neighbour> result;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            nearest(queries[i], k, result);
+            std::copy(result.begin(), result.end(), out.begin() + i * k);
+        }
+    }
+
+  private:
+    struct Node {
+        uint32_t index;  ///< Node i holds point i
+        uint32_t left, right;
+        uint32_t axis;   ///< 0 splits on x, 1 on y
+        uint32_t count;  ///< Number of points in the subtree
+    };
+
+    static float coordinate(Point p, uint32_t axis) {
+        return axis == 0 ? p.x : p.y;
+    }
+    static bool closer(const Neighbour &a, const Neighbour &b) {
+        return a.distanceSquared < b.distanceSquared;
+    }
+    uint32_t count(uint32_t node) const {
+        return node == NONE ? 0 : nodes[node].count;
+    }
+    /// One of the subtrees has more than 3/4 of the points.
+    bool unbalanced(const Node &n) const {
+        return 4 * std::max(count(n.left), count(n.right)) > 3 * n.count;
+    }
+
+    void rebuild() {
+        nodes.assign(points.size(), {0, NONE, NONE, 0, 0});
+        std::vector<uint32_t> order(points.size());
+        std::iota(order.begin(), order.end(), 0);
+        root = build(order.data(), order.size(), 0);
+    }
+
+    /// Rebuild the subtree of a node, and attach it to the parent.
+    void rebuild(uint32_t parent, uint32_t node) {
+        std::vector<uint32_t> order;
+        order.reserve(nodes[node].count);
+        collect(node, order);
+        uint32_t subtree = build(order.data(), order.size(), nodes[node].axis);
+        if (parent == NONE)
+            root = subtree;
+        else if (nodes[parent].left == node)
+            nodes[parent].left = subtree;
+        else
+            nodes[parent].right = subtree;
+    }
+
+    void collect(uint32_t node, std::vector<uint32_t> &order) const {
+        if (node == NONE)
+            return;
+        order.push_back(node);
+        collect(nodes[node].left, order);
+        collect(nodes[node].right, order);
+    }
+
+    /// Build a subtree of the given points, split at the median. Points on
+    /// the left have coordinates less than or equal to the median, points on
+    /// the right greater than or equal, which is all the queries assume.
+    uint32_t build(uint32_t *order, size_t n, uint32_t axis) {
+        if (n == 0)
+            return NONE;
+        size_t mid = n / 2;
+        std::nth_element(order, order + mid, order + n,
+                         [&](uint32_t a, uint32_t b) {
+                             return coordinate(points[a], axis) <
+                                    coordinate(points[b], axis);
+                         });
+        uint32_t index = order[mid];
+        Node &node     = nodes[index];
+        node.index     = index;
+        node.axis      = axis;
+        node.count     = uint32_t(n);
+        node.left      = build(order, mid, axis ^ 1);
+        node.right     = build(order + mid + 1, n - mid - 1, axis ^ 1);
+        return index;
+    }
+
+    /// `out` is a max-heap of the best candidates so far.
+    void nearest(uint32_t node, Point q, size_t k,
+                 std::vector<Neighbour> &out) const {
+        if (node == NONE)
+            return;
+        const Node &n = nodes[node];
+        Point p       = points[n.index];
+        float d2      = Point::distanceSquared(q, p);
+        if (out.size() < k) {
+            out.push_back({n.index, d2});
+            std::push_heap(out.begin(), out.end(), closer);
+        } else if (d2 < out.front().distanceSquared) {
+            std::pop_heap(out.begin(), out.end(), closer);
+            out.back() = {n.index, d2};
+            std::push_heap(out.begin(), out.end(), closer);
+        }
+        float diff = coordinate(q, n.axis) - coordinate(p, n.axis);
+        nearest(diff < 0 ? n.left : n.right, q, k, out);
+        if (out.size() < k || diff * diff < out.front().distanceSquared)
+            nearest(diff < 0 ? n.right : n.left, q, k, out);
+    }
+
+    void withinRadius(uint32_t node, Point q, float r2,
+                      std::vector<Neighbour> &out) const {
+        if (node == NONE)
+            return;
+        const Node &n = nodes[node];
+        Point p       = points[n.index];
+        float d2      = Point::distanceSquared(q, p);
+        if (d2 <= r2)
+            out.push_back({n.index, d2});
+        float diff = coordinate(q, n.axis) - coordinate(p, n.axis);
+        withinRadius(diff < 0 ? n.left : n.right, q, r2, out);
+        if (diff * diff <= r2)
+            withinRadius(diff < 0 ? n.right : n.left, q, r2, out);
+    }
+
+    std::vector<Point> points;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> path;  ///< Scratch space for insert()
+    uint32_t root = NONE;
+};
+
+//============================================================================//
+
+/**
+ * @brief   Fixed set of worker threads that run the iterations of a parallel
+ *          loop, with work stealing.
+ *
+ * Each worker has its own queue of iterations. It takes work from the back of
+ * its own queue, and when that is empty, steals from the front of the queues
+ * of the other workers, so all threads stay busy even when some iterations
+ * take much longer than others.
+ */
+class WorkStealingPool {
+  public:
+    explicit WorkStealingPool(
+        size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+        for (size_t i = 0; i < threads; ++i)
+            queues.push_back(std::make_unique<Queue>());
+        for (size_t i = 0; i < threads; ++i)
+            workers.emplace_back(&WorkStealingPool::work, this, i);
+    }
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    /// Call f(i) for every i in [0, count) on the workers, and wait until all
+    /// calls returned. Rethrows the first exception thrown by f. Calls from
+    /// different threads run one after the other. Don't call it from f.
+    template <class F>
+    void parallelFor(size_t count, F f) {
+        if (count == 0)
+            return;
+        std::lock_guard<std::mutex> call(callMutex);
+        std::unique_lock<std::mutex> lock(mutex);
+        job       = std::move(f);
+        error     = nullptr;
+        remaining = count;
+        for (size_t i = 0; i < count; ++i) {
+            Queue &q = *queues[i % queues.size()];
+            std::lock_guard<std::mutex> qlock(q.mutex);
+            q.tasks.push_back(i);
+        }
+        ++generation;
+        wake.notify_all();
+        done.wait(lock, [&] { return remaining == 0; });
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+  private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    /// Take an iteration from the worker's own queue, or steal one.
+    bool take(size_t self, size_t &task) {
+        for (size_t i = 0; i < queues.size(); ++i) {
+            Queue &q = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty())
+                continue;
+            if (i == 0) {
+                task = q.tasks.back();
+                q.tasks.pop_back();
+            } else {
+                task = q.tasks.front();
+                q.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void work(size_t self) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock,
+                          [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            size_t task;
+            while (take(self, task)) {
+                try {
+                    job(task);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.notify_all();
+                }
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex callMutex;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::function<void(size_t)> job;
+    std::atomic<size_t> remaining = {0};
+    uint64_t generation           = 0;
+    bool stopping                 = false;
+    std::exception_ptr error;
+};
+
+//============================================================================//
+
+// Distance matrices between two point clouds, split into tiles that are
+// spread over a WorkStealingPool. A tile covers DISTANCE_TILE_ROWS points of
+// the first cloud and DISTANCE_TILE_COLS points of the second one: the
+// coordinates of the columns (8 KiB) and one row of distances (4 KiB) stay
+// in the L1 cache while all rows of the tile are computed.
+//
+// The distances are computed with the PointCloud kernels instead of
+// Point::distance: the TColVector math only vectorizes over the two
+// coordinates of a single pair of points, the kernels over a row of the
+// tile. They do the same operations in the same order, so the results are
+// those of Point::distance (see PointCloud for the exception with FMA).
+
+constexpr size_t DISTANCE_TILE_ROWS = 64;
+constexpr size_t DISTANCE_TILE_COLS = 1024;
+
+/**
+ * @brief   Compute all distances between the points of `rows` and `cols`.
+ *
+ * @param   out
+ *          rows.size() × cols.size() distances, row-major.
+ * @param   squared
+ *          Store squared distances instead, e.g. as the costs of an
+ *          assignment problem.
+ */
+inline void distanceMatrix(WorkStealingPool &pool, const PointCloud &rows,
+                           const PointCloud &cols, float *out,
+                           bool squared = false) {
+    size_t colTiles = (cols.size() + DISTANCE_TILE_COLS - 1) /
+                      DISTANCE_TILE_COLS;
+    size_t rowTiles = (rows.size() + DISTANCE_TILE_ROWS - 1) /
+                      DISTANCE_TILE_ROWS;
+    pool.parallelFor(rowTiles * colTiles, [&](size_t tile) {
+        size_t r0 = tile / colTiles * DISTANCE_TILE_ROWS;
+        size_t c0 = tile % colTiles * DISTANCE_TILE_COLS;
+        size_t r1 = std::min(r0 + DISTANCE_TILE_ROWS, rows.size());
+        size_t n  = std::min(DISTANCE_TILE_COLS, cols.size() - c0);
+        for (size_t r = r0; r < r1; ++r) {
+            float *dst = out + r * cols.size() + c0;
+            kernels::distancesSquared(cols.x() + c0, cols.y() + c0,
+                                      rows.x()[r], rows.y()[r], dst, n);
+            if (!squared)
+                kernels::squareRoots(dst, n);
+        }
+    });
+}
+
+/**
+ * @brief   Stream the squared distances between the points of `rows` and
+ *          `cols` to a reduction, without storing the matrix.
+ *
+ * Calls `reduce(row, firstCol, distancesSquared, count)` for every row and
+ * every tile of columns. All columns of a row are passed to the same thread,
+ * in order, but different rows are reduced in parallel.
+ */
+template <class Reduce>
+void reduceRows(WorkStealingPool &pool, const PointCloud &rows,
+                const PointCloud &cols, Reduce reduce) {
+    size_t rowTiles = (rows.size() + DISTANCE_TILE_ROWS - 1) /
+                      DISTANCE_TILE_ROWS;
+    pool.parallelFor(rowTiles, [&](size_t tile) {
+        float d2[DISTANCE_TILE_COLS];
+        size_t r0 = tile * DISTANCE_TILE_ROWS;
+        size_t r1 = std::min(r0 + DISTANCE_TILE_ROWS, rows.size());
+        for (size_t c0 = 0; c0 < cols.size(); c0 += DISTANCE_TILE_COLS) {
+            size_t n = std::min(DISTANCE_TILE_COLS, cols.size() - c0);
+            for (size_t r = r0; r < r1; ++r) {
+                kernels::distancesSquared(cols.x() + c0, cols.y() + c0,
+                                          rows.x()[r], rows.y()[r], d2, n);
+                reduce(r, c0, static_cast<const float *>(d2), n);
+            }
+        }
+    });
+}
+
+/// For every point of `rows`, the distance to and the index of the closest
+/// point of `cols` (the first one if there are several). `cols` must not be
+/// empty.
+inline void rowMinimum(WorkStealingPool &pool, const PointCloud &rows,
+                       const PointCloud &cols, float *minimum,
+                       uint32_t *argmin) {
+    reduceRows(pool, rows, cols,
+               [&](size_t r, size_t c0, const float *d2, size_t n) {
+                   // Only look for the index if the tile has a new minimum
+                   float best = kernels::minimum(d2, n);
+                   if (c0 == 0 || best < minimum[r]) {
+                       const float *first = std::find(d2, d2 + n, best);
+                       minimum[r]         = best;
+                       argmin[r]          = uint32_t(c0 + (first - d2));
+                   }
+               });
+    kernels::squareRoots(minimum, rows.size());
+}
+
 using namespace std;
+#include <chrono>
 #include <iomanip>
+#include <random>
+
+/// Random points in a 1000 × 1000 square.
+vector<Point> randomPoints(size_t n, unsigned seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<float> coordinate(0, 1000);
+    vector<Point> points(n);
+    for (Point &p : points)
+        p = {coordinate(rng), coordinate(rng)};
+    return points;
+}
+
+/// Equal within 1 ulp. Distances that are computed in different places may
+/// round differently under FMA contraction (-std=gnu++17).
+bool near(float a, float b) { return abs(a - b) <= nextafter(b, INFINITY) - b; }
+
+/// Compare the k-d tree queries to brute force.
+bool checkKdTree() {
+    vector<Point> points = randomPoints(2000, 1);
+    KdTree tree({points.begin(), points.begin() + 1000});
+    sort(points.begin() + 1000, points.end(),  // Worst case for insert()
+         [](Point a, Point b) { return a.x < b.x; });
+    for (size_t i = 1000; i < points.size(); ++i)
+        tree.insert(points[i]);
+    points.push_back(points[3]);  // Duplicate
+    tree.insert(points.back());
+
+    bool success = true;
+    vector<KdTree::Neighbour> found;
+    vector<float> all(points.size());
+    for (Point q : randomPoints(200, 2)) {
+        for (size_t i = 0; i < points.size(); ++i)
+            all[i] = Point::distanceSquared(q, points[i]);
+        tree.nearest(q, 5, found);
+        vector<float> sorted = all;
+        sort(sorted.begin(), sorted.end());
+        success &= found.size() == 5;
+        for (size_t i = 0; i < found.size(); ++i)
+            success &= near(found[i].distanceSquared, sorted[i]) &&
+                       near(all[found[i].index], sorted[i]);
+        tree.radius(q, 50, found);
+        success &= found.size() == size_t(count_if(all.begin(), all.end(),
+                                                   [](float d2) {
+                                                       return d2 <= 50 * 50;
+                                                   }));
+    }
+
+    // Inserting points in order rebuilds subtrees, not the entire tree: four
+    // times as many points should take about five times as long, not sixteen
+    auto insertDiagonal = [](size_t n) {
+        auto start = chrono::steady_clock::now();
+        KdTree diagonal;
+        for (size_t i = 0; i < n; ++i)
+            diagonal.insert({float(i), float(i)});
+        return chrono::duration<double>(chrono::steady_clock::now() - start)
+            .count();
+    };
+    success &= insertDiagonal(40'000) < 10 * insertDiagonal(10'000);
+    return success;
+}
+
+/// Compare the tiled, multi-threaded distance matrices to PointCloud.
+bool checkDistanceMatrix() {
+    PointCloud rows, cols;
+    for (Point p : randomPoints(300, 5))
+        rows.push_back(p);
+    for (Point p : randomPoints(2500, 6))  // Several column tiles
+        cols.push_back(p);
+    WorkStealingPool pool(3);
+    vector<float> matrix(rows.size() * cols.size()), row(cols.size());
+    distanceMatrix(pool, rows, cols, matrix.data());
+    vector<float> minimum(rows.size());
+    vector<uint32_t> argmin(rows.size());
+    rowMinimum(pool, rows, cols, minimum.data(), argmin.data());
+
+    bool success = true;
+    for (size_t r = 0; r < rows.size(); ++r) {
+        cols.distances(rows[r], row.data());
+        success &= equal(row.begin(), row.end(),
+                         matrix.begin() + r * cols.size());
+        for (size_t c = 0; c < cols.size(); ++c)
+            success &= near(row[c], Point::distance(rows[r], cols[c]));
+        auto best = min_element(row.begin(), row.end());
+        success &= minimum[r] == *best &&
+                   argmin[r] == size_t(best - row.begin());
+    }
+    return success;
+}
+
+/// Scaling of the distance matrix engine with the number of threads.
+void benchmarkDistanceMatrix(size_t n) {
+    using clk = chrono::steady_clock;
+    PointCloud rows, cols;
+    for (Point p : randomPoints(n, 7))
+        rows.push_back(p);
+    for (Point p : randomPoints(n, 8))
+        cols.push_back(p);
+    vector<float> minimum(n);
+    vector<uint32_t> argmin(n);
+    // Powers of two, and all cores
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < cores; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(cores);
+    for (unsigned threads : threadCounts) {
+        WorkStealingPool pool(threads);
+        auto start = clk::now();
+        rowMinimum(pool, rows, cols, minimum.data(), argmin.data());
+        double seconds = chrono::duration<double>(clk::now() - start).count();
+        cout << n << " × " << n << " row minimum: " << threads
+             << " threads, " << seconds << " s, " << n * n / seconds / 1e9
+             << " G distances/s" << endl;
+    }
+}
+
+/// Associate the points of one frame with the closest points of the next.
+void benchmarkKdTree(size_t n) {
+    using clk          = chrono::steady_clock;
+    vector<Point> prev = randomPoints(n, 3), next = randomPoints(n, 4);
+    auto seconds       = [](clk::time_point start) {
+        return chrono::duration<double>(clk::now() - start).count();
+    };
 
-int main() {
+    auto start = clk::now();
+    vector<uint32_t> brute(n);
+    for (size_t i = 0; i < n; ++i) {
+        float best = INFINITY;
+        for (size_t j = 0; j < n; ++j) {
+            float d2 = Point::distanceSquared(next[i], prev[j]);
+            if (d2 < best) {
+                best     = d2;
+                brute[i] = j;
+            }
+        }
+    }
+    double bruteTime = seconds(start);
+
+    start = clk::now();
+    KdTree tree(prev);
+    double buildTime = seconds(start);
+    vector<KdTree::Neighbour> nearest;
+    tree.nearest(next, 1, nearest);
+    double treeTime = seconds(start);
+
+    size_t same = 0;
+    for (size_t i = 0; i < n; ++i)
+        same += nearest[i].index == brute[i];
+    cout << n << " × " << n << " points: brute force " << bruteTime
+         << " s, k-d tree " << treeTime << " s (build " << buildTime
+         << " s), " << same << " identical matches" << endl;
+}
+
+int main(int argc, char *argv[]) {
     Point p0       = {185.04774475097656, 254.54849243164062};
     Point p1       = {453.23568725585938, 237.98394775390625};
     float result   = Point::distance(p0, p1);
     float expected = 268.69900512695312;
     cout << setprecision(7) << result << endl;
     bool success = result == expected;
+
+    // The SIMD kernels sum in a different order than the scalar ones, both are
+    // within n·ε (relative) of the exact result
+    static TColVector<float, 1000> u, v;
+    for (size_t i = 0; i < 1000; ++i) {
+        u[i] = 0.5f * i;
+        v[i] = 1000.f - i;
+    }
+    float dotSimd   = u * v;
+    float dotScalar = kernels::scalar::dot(u.flat(), v.flat(), 1000);
+    cout << dotSimd << " (SIMD), " << dotScalar << " (scalar)" << endl;
+    float tolerance = 1000 * numeric_limits<float>::epsilon();
+    success &= abs(dotSimd - dotScalar) <= tolerance * abs(dotScalar);
+
+    // Element-wise operators give the same results with and without SIMD,
+    // also for the remainder that doesn't fill a whole vector
+    static Array<float, 8> a8, b8;
+    static TMatrix<double, 3, 5> a15, b15;
+    for (size_t i = 0; i < 8; ++i) {
+        a8[i] = 10.f + i;
+        b8[i] = 1.f + 0.25f * i;
+    }
+    for (size_t i = 0; i < 15; ++i) {
+        a15[i / 5][i % 5] = 10.0 + i;
+        b15[i / 5][i % 5] = 1.0 + 0.25 * i;
+    }
+    auto c8 = a8;
+    auto c15 = a15;
+    c8 -= b8, c15 -= b15;
+    for (size_t i = 0; i < 8; ++i)
+        success &= c8[i] == a8[i] - b8[i];
+    for (size_t i = 0; i < 15; ++i)
+        success &= c15.flat()[i] == a15.flat()[i] - b15.flat()[i];
+    success &= (a8 - b8)[0] == 9.f;
+    c8 = a8, c15 = a15;
+    c8 += b8, c15 += b15;
+    for (size_t i = 0; i < 8; ++i)
+        success &= c8[i] == a8[i] + b8[i];
+    for (size_t i = 0; i < 15; ++i)
+        success &= c15.flat()[i] == a15.flat()[i] + b15.flat()[i];
+    c8 = a8, c15 = a15;
+    c8 *= 0.5f, c15 *= 0.5;
+    for (size_t i = 0; i < 8; ++i)
+        success &= c8[i] == a8[i] * 0.5f;
+    for (size_t i = 0; i < 15; ++i)
+        success &= c15.flat()[i] == a15.flat()[i] * 0.5;
+
+    // Fused expressions give the same results as evaluating step by step
+    static TMatrix<double, 12, 12> A;
+    static TColVector<double, 12> x, b;
+    for (size_t i = 0; i < 12; ++i) {
+        for (size_t j = 0; j < 12; ++j)
+            A[i][j] = 1.0 / (i + j + 1);
+        x[i][0] = i;
+        b[i][0] = 12.0 - i;
+    }
+    TColVector<double, 12> Ax = A * x, residual = A * x - b;
+    for (size_t i = 0; i < 12; ++i)
+        success &= residual[i][0] == Ax[i][0] - b[i][0];
+    success &= double(normsq(A * x - b)) ==
+               kernels::scalar::dot(residual.flat(), residual.flat(), 12);
+    x = A * x;  // Reads x, evaluated into a temporary first
+    success &= x[11][0] == Ax[11][0];
+
+    // Blocked products sum in the same order as unblocked ones
+    static TMatrix<float, 100, 80> L;
+    static TMatrix<float, 80, 90> R;
+    static TMatrix<float, 100, 90> LR;
+    for (size_t i = 0; i < 100; ++i)
+        for (size_t k = 0; k < 80; ++k)
+            L[i][k] = float(i) - k / 3.f;
+    for (size_t k = 0; k < 80; ++k)
+        for (size_t j = 0; j < 90; ++j)
+            R[k][j] = float(j) / (k + 1);
+    auto product = L * R;
+    LR           = product;
+    success &= LR[99][89] == product(99, 89) && LR[17][3] == product(17, 3);
+
+    // Batched distances match Point::distance
+    PointCloud cloud = {p1, p0, {0, 0}, {-3.5f, 12.25f}, {1e3f, -1e3f}};
+    for (int i = 0; i < 40; ++i)
+        cloud.push_back({i * 17.125f, 300 - i * 9.5f});
+    vector<float> d(cloud.size());
+    cloud.distances(p0, d.data());
+    success &= d[0] == expected && d[1] == 0;
+    for (size_t i = 0; i < cloud.size(); ++i) {
+        float ref = Point::distance(p0, cloud[i]);
+        success &= abs(d[i] - ref) <= nextafter(ref, INFINITY) - ref;
+    }
+    vector<float> pairwise(cloud.size() * cloud.size());
+    cloud.pairwiseDistances(cloud, pairwise.data());
+    success &= pairwise[1 * cloud.size() + 0] == expected;
+    vector<uint8_t> mask(cloud.size());
+    success &= cloud.withinRadius(p0, expected + 1, mask.data()) >= 2 &&
+               mask[0] && mask[1] && !mask[4];
+
+    // Fixed-point geometry, at compile time and at run time
+    using Q2 = TColVector<Q16_16, 2>;
+    static_assert(norm(Q2{Q16_16(3), Q16_16(4)}) == Q16_16(5));
+    static_assert(Q16_16(30000) + Q16_16(30000) == Q16_16::max());
+    static_assert(Q16_16(-2.5) * Q16_16(3) == Q16_16(-7.5));
+    constexpr auto sqrtTable = [] {
+        Array<Q16_16, 16> table = {};
+        for (int i = 0; i < 16; ++i)
+            table[i] = sqrt(Q16_16(i));
+        return table;
+    }();
+    static_assert(sqrtTable[9] == Q16_16(3));
+    static_assert(Fixed<7, int8_t>(300) == Fixed<7, int8_t>::max());
+    static_assert(Fixed<4, int8_t>(-3000) == Fixed<4, int8_t>::min());
+    static_assert(Fixed<4, int8_t>(-8) == Fixed<4, int8_t>::min());
+    static_assert(Q16_16(int64_t(1) << 40) == Q16_16::max());
+    static_assert(Q16_16(UINT64_MAX) == Q16_16::max());
+    static_assert(Q16_16(INT64_MIN) == Q16_16::min());
+    static_assert(sqrt(Q8_8(100)) == Q8_8(10));
+    static_assert(sqrt(Fixed<4, int8_t>(4)) == Fixed<4, int8_t>(2));
+    TColVector<Q24_8, 2> q0 = {Q24_8(double(p0.x)), Q24_8(double(p0.y))};
+    TColVector<Q24_8, 2> q1 = {Q24_8(double(p1.x)), Q24_8(double(p1.y))};
+    auto fixedDistance      = double(norm(q0 - q1));
+    cout << fixedDistance << " (Q24.8)" << endl;
+    success &= abs(fixedDistance - expected) < 0.01;
+
+    success &= checkKdTree();
+    success &= checkDistanceMatrix();
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        benchmarkKdTree(20'000);
+        benchmarkDistanceMatrix(20'000);
+    }
     return success ? 0 : 1;
 }
 
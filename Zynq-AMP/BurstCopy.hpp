@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>      // size_t
+#include <cstdint>      // uint8_t, uint32_t
+#include <cstring>      // memcmp
+#include <new>          // launder
+#include <type_traits>  // is_trivially_copyable
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Size of the widest load or store that is used to copy shared structs. Every
+// access to uncached shared memory is a separate bus transaction, so fewer,
+// wider accesses are much faster than accessing one field at a time.
+#if defined(__AVX__)
+constexpr size_t BURST_SIZE = 32;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__SSE2__)
+constexpr size_t BURST_SIZE = 16;
+#else
+constexpr size_t BURST_SIZE = 4;
+#endif
+
+/// Keeps the compiler from merging or reordering the copies with other
+/// accesses, since the wide loads and stores themselves are not volatile.
+inline void compilerBarrier() { __asm__ __volatile__("" ::: "memory"); }
+
+/// Copy BURST_SIZE bytes from the shared memory, in a single access.
+inline void burstLoad(void *dst, const volatile void *src) {
+    const void *s = const_cast<const void *>(src);
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    vst1q_u8(static_cast<uint8_t *>(dst), vld1q_u8((const uint8_t *) s));
+#elif defined(__AVX__)
+    _mm256_storeu_si256(static_cast<__m256i *>(dst),
+                        _mm256_loadu_si256(static_cast<const __m256i *>(s)));
+#elif defined(__SSE2__)
+    _mm_storeu_si128(static_cast<__m128i *>(dst),
+                     _mm_loadu_si128(static_cast<const __m128i *>(s)));
+#else
+    uint32_t word = *static_cast<const volatile uint32_t *>(src);
+    std::memcpy(dst, &word, sizeof(word));
+#endif
+}
+
+/// Copy BURST_SIZE bytes to the shared memory, in a single access.
+inline void burstStore(volatile void *dst, const void *src) {
+    void *d = const_cast<void *>(dst);
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    vst1q_u8((uint8_t *) d, vld1q_u8(static_cast<const uint8_t *>(src)));
+#elif defined(__AVX__)
+    _mm256_storeu_si256(static_cast<__m256i *>(d),
+                        _mm256_loadu_si256(static_cast<const __m256i *>(src)));
+#elif defined(__SSE2__)
+    _mm_storeu_si128(static_cast<__m128i *>(d),
+                     _mm_loadu_si128(static_cast<const __m128i *>(src)));
+#else
+    uint32_t word;
+    std::memcpy(&word, src, sizeof(word));
+    *static_cast<volatile uint32_t *>(dst) = word;
+#endif
+}
+
+/**
+ * @brief   Copy a block from the shared memory with the widest available
+ *          loads.
+ *
+ * @param   dst
+ *          Local memory, no alignment requirements.
+ * @param   src
+ *          Shared memory. Should be aligned to BURST_SIZE, unaligned
+ *          accesses fault if it's mapped as device or strongly-ordered
+ *          memory (every struct in the shared memory layout is aligned to a
+ *          cache line).
+ * @param   size
+ *          Number of bytes to copy.
+ */
+inline void burstRead(void *dst, const volatile void *src, size_t size) {
+    auto *d = static_cast<uint8_t *>(dst);
+    auto *s = static_cast<const volatile uint8_t *>(src);
+    compilerBarrier();
+    size_t i = 0;
+    for (; i + BURST_SIZE <= size; i += BURST_SIZE)
+        burstLoad(d + i, s + i);
+    for (; i < size; ++i)
+        d[i] = s[i];
+    compilerBarrier();
+}
+
+/**
+ * @brief   Write the parts of a block that differ from a reference copy to
+ *          the shared memory, with the widest available stores.
+ *
+ * Bursts that changed are written as a whole, including the unchanged bytes
+ * next to the changed ones.
+ *
+ * @param   dst
+ *          Shared memory, should be aligned to BURST_SIZE (see burstRead).
+ * @param   src
+ *          Local copy with the new contents.
+ * @param   base
+ *          Local copy of the original contents, e.g. from burstRead.
+ * @param   size
+ *          Number of bytes.
+ * @return  The number of bursts written.
+ */
+inline size_t burstWriteChanged(volatile void *dst, const void *src,
+                                const void *base, size_t size) {
+    auto *d = static_cast<volatile uint8_t *>(dst);
+    auto *s = static_cast<const uint8_t *>(src);
+    auto *b = static_cast<const uint8_t *>(base);
+    size_t bursts = 0;
+    compilerBarrier();
+    size_t i = 0;
+    for (; i + BURST_SIZE <= size; i += BURST_SIZE) {
+        if (std::memcmp(s + i, b + i, BURST_SIZE) != 0) {
+            burstStore(d + i, s + i);
+            ++bursts;
+        }
+    }
+    if (i < size && std::memcmp(s + i, b + i, size - i) != 0) {
+        for (; i < size; ++i)
+            d[i] = s[i];
+        ++bursts;
+    }
+    compilerBarrier();
+    return bursts;
+}
+
+/**
+ * @brief   Copy an entire struct from the shared memory into a local,
+ *          non-volatile struct.
+ *
+ * This is not atomic: use SeqlockShared or TripleBuffer if the other core may
+ * be writing at the same time.
+ */
+template <class T>
+T sharedSnapshot(const volatile T &shared) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+    alignas(T) uint8_t buffer[sizeof(T)];
+    burstRead(buffer, &shared, sizeof(T));
+    return *std::launder(reinterpret_cast<T *>(buffer));
+}
+
+/**
+ * @brief   Write the fields of a local copy that were changed since the
+ *          snapshot it was made from back to the shared memory.
+ *
+ * Only use this for structs (or the parts of them) that the other core never
+ * writes: unchanged fields in the same burst as a changed one are written
+ * back as well.
+ *
+ * @return  The number of bursts written.
+ */
+template <class T>
+size_t sharedCommit(volatile T &shared, const T &local, const T &base) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+    return burstWriteChanged(&shared, &local, &base, sizeof(T));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>  // uint32_t, uint64_t
+#ifdef BAREMETAL
+#include <xtime_l.h>
+#else
+#include <time.h>
+#endif
+
+/// Tell the CPU that we're busy-waiting.
+inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
+/// Monotonic time in microseconds.
+inline uint64_t monotonicMicros() {
+#ifdef BAREMETAL
+    XTime t;
+    XTime_GetTime(&t);
+    return t / (COUNTS_PER_SECOND / 1'000'000);
+#else
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return uint64_t(t.tv_sec) * 1'000'000 + t.tv_nsec / 1'000;
+#endif
+}
+
+/// Cheap, high-resolution timestamp: the global timer on bare-metal, the
+/// monotonic clock in nanoseconds on Linux.
+inline uint64_t timestampTicks() {
+#ifdef BAREMETAL
+    XTime t;
+    XTime_GetTime(&t);
+    return t;
+#else
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return uint64_t(t.tv_sec) * 1'000'000'000 + t.tv_nsec;
+#endif
+}
+
+/// Frequency of timestampTicks().
+#ifdef BAREMETAL
+constexpr uint32_t TICKS_PER_SECOND = COUNTS_PER_SECOND;
+#else
+constexpr uint32_t TICKS_PER_SECOND = 1'000'000'000;
+#endif
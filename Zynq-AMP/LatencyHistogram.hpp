@@ -0,0 +1,152 @@
+#pragma once
+
+#include <SharedMemConfig.hpp>  // CACHE_LINE_SIZE
+
+#include <algorithm>  // min
+#include <atomic>     // atomic
+#include <cstddef>    // size_t
+#include <cstdint>    // uint32_t, uint64_t
+#include <iomanip>    // setw, setprecision
+#include <iostream>   // ostream
+
+/**
+ * @brief   Fixed-size log-linear (HDR-style) histogram of latencies, that can
+ *          live in the shared memory.
+ *
+ * Values below 2^SubBits have their own bucket, larger values are grouped per
+ * power of two, which is divided into 2^SubBits linear sub-buckets. The
+ * relative error is therefore at most 2^-SubBits, for any value up to 2^32.
+ *
+ * There's a single writer, so recording is a plain load and store of one
+ * counter, without read-modify-write instructions. Readers take a Snapshot
+ * without writing to the shared memory, the difference between two snapshots
+ * gives the histogram of that interval.
+ *
+ * @tparam  SubBits
+ *          Base-2 logarithm of the number of sub-buckets per power of two.
+ */
+template <unsigned SubBits = 4>
+class LatencyHistogram {
+  public:
+    constexpr static uint32_t SUB_BUCKETS = 1u << SubBits;
+    constexpr static size_t NUM_BUCKETS   = SUB_BUCKETS * (33 - SubBits);
+
+    /// Index of the bucket that contains the given value.
+    static constexpr size_t bucketOf(uint32_t value) {
+        if (value < SUB_BUCKETS)
+            return value;
+        unsigned msb   = 31 - __builtin_clz(value);
+        unsigned shift = msb - SubBits;
+        return SUB_BUCKETS * (shift + 1) + (value >> shift) - SUB_BUCKETS;
+    }
+    /// Smallest value in the given bucket.
+    static constexpr uint64_t lowerBound(size_t bucket) {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+        unsigned shift = bucket / SUB_BUCKETS - 1;
+        return uint64_t(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    }
+    /// Largest value in the given bucket.
+    static constexpr uint64_t upperBound(size_t bucket) {
+        return lowerBound(bucket + 1) - 1;
+    }
+
+    /// Copy of the histogram, local to the reader.
+    struct Snapshot {
+        uint32_t counts[NUM_BUCKETS];
+        uint32_t max;
+        uint32_t ticksPerSecond;
+
+        uint64_t count() const {
+            uint64_t n = 0;
+            for (uint32_t c : counts)
+                n += c;
+            return n;
+        }
+        /// Upper bound of the bucket that contains the given percentile
+        /// (0-100), in ticks.
+        uint64_t percentile(double p) const {
+            uint64_t n = count(), seen = 0;
+            uint64_t rank = n * p / 100;
+            for (size_t i = 0; i < NUM_BUCKETS; ++i)
+                if ((seen += counts[i]) > rank || seen == n)
+                    return std::min<uint64_t>(upperBound(i), max);
+            return 0;
+        }
+        /// Largest value, or an upper bound for an interval.
+        uint64_t maximum() const {
+            for (size_t i = NUM_BUCKETS; i-- > 0;)
+                if (counts[i] > 0)
+                    return std::min<uint64_t>(upperBound(i), max);
+            return 0;
+        }
+        /// Histogram of the values recorded since the given older snapshot.
+        Snapshot since(const Snapshot &older) const {
+            Snapshot interval = *this;
+            for (size_t i = 0; i < NUM_BUCKETS; ++i)
+                interval.counts[i] -= older.counts[i];
+            return interval;
+        }
+    };
+
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    /// Set the unit of the recorded values. Writer only.
+    void setTicksPerSecond(uint32_t ticksPerSecond) {
+        this->ticksPerSecond.store(ticksPerSecond, std::memory_order_relaxed);
+    }
+
+    /// Record a latency in ticks. Writer only.
+    void record(uint32_t ticks) {
+        auto &c = counts[bucketOf(ticks)];
+        c.store(c.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+        if (ticks > max.load(std::memory_order_relaxed))
+            max.store(ticks, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const {
+        Snapshot s;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i)
+            s.counts[i] = counts[i].load(std::memory_order_relaxed);
+        s.max            = max.load(std::memory_order_relaxed);
+        s.ticksPerSecond = ticksPerSecond.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void setTicksPerSecond(uint32_t ticksPerSecond) volatile {
+        self()->setTicksPerSecond(ticksPerSecond);
+    }
+    void record(uint32_t ticks) volatile { self()->record(ticks); }
+    Snapshot snapshot() const volatile { return self()->snapshot(); }
+
+  private:
+    LatencyHistogram *self() volatile {
+        return const_cast<LatencyHistogram *>(this);
+    }
+    const LatencyHistogram *self() const volatile {
+        return const_cast<const LatencyHistogram *>(this);
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> max = {0};
+    std::atomic<uint32_t> ticksPerSecond               = {1'000'000'000};
+    std::atomic<uint32_t> counts[NUM_BUCKETS]          = {};
+};
+
+/// Print the count, percentiles and maximum of a histogram in microseconds.
+template <class Snapshot>
+void printLatencies(std::ostream &os, const char *name, const Snapshot &s) {
+    double us      = 1e6 / s.ticksPerSecond;
+    auto flags     = os.flags();
+    auto precision = os.precision();
+    os << std::fixed << std::setprecision(2) << std::setw(10) << name << ": "
+       << std::setw(8) << s.count() << " samples, p50 = "
+       << s.percentile(50) * us << " µs, p90 = " << s.percentile(90) * us
+       << " µs, p99 = " << s.percentile(99) * us
+       << " µs, p99.9 = " << s.percentile(99.9) * us
+       << " µs, max = " << s.maximum() * us << " µs" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
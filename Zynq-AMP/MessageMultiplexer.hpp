@@ -0,0 +1,199 @@
+#pragma once
+
+#include <CpuUtils.hpp>       // cpuRelax
+#include <SharedStructs.hpp>  // MessageChannel, Message
+#include <SharedWait.hpp>     // notify
+
+#include <condition_variable>  // condition_variable
+#include <cstddef>             // size_t
+#include <cstdint>             // uint32_t, uint64_t
+#include <deque>               // deque
+#include <future>              // future, promise
+#include <mutex>               // mutex, lock_guard, unique_lock
+#include <thread>              // thread, yield
+#include <vector>              // vector
+
+/**
+ * @brief   Lets any number of Linux threads exchange messages with the
+ *          bare-metal core over a single MessageChannel.
+ *
+ * The rings of the channel only support a single producer and consumer, so
+ * one I/O thread owns the Linux side of the channel. Threads hand their
+ * messages to the I/O thread, which sends everything that was queued in the
+ * meantime as one batch: a single index update and a single notification of
+ * Baremetal, however many threads sent something. The `id` of each message
+ * is replaced by a tag that routes the reply back to the future of the
+ * sender, so Baremetal has to copy the `id` of a message into its reply.
+ *
+ * At most one ring of messages is in flight at once, so Baremetal never has
+ * to wait for room in the reply ring.
+ *
+ * @tparam  Doorbell
+ *          Doorbell that wakes up Baremetal, see SharedWait.hpp.
+ */
+template <class Doorbell>
+class MessageMultiplexer {
+  public:
+    constexpr static size_t CAPACITY =
+        decltype(MessageChannel::linux2baremetal)::capacity();
+
+    struct Stats {
+        uint64_t messages;  ///< Messages sent
+        uint64_t batches;   ///< Index updates and notifications of Baremetal
+    };
+
+    MessageMultiplexer(volatile MessageChannel *channel, Doorbell &doorbell)
+        : channel(channel), doorbell(doorbell) {
+        for (uint32_t slot = 0; slot < CAPACITY; ++slot)
+            freeSlots.push_back(slot);
+        thread = std::thread(&MessageMultiplexer::run, this);
+    }
+    /// Stops the I/O thread. Futures of messages without a reply yet get a
+    /// `std::future_error` (broken promise).
+    ~MessageMultiplexer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+    MessageMultiplexer(const MessageMultiplexer &) = delete;
+    MessageMultiplexer &operator=(const MessageMultiplexer &) = delete;
+
+    /// Send a value to Baremetal. Thread-safe. The future gets the value of
+    /// the reply.
+    std::future<uint32_t> send(uint32_t value) {
+        Pending p{value, {}};
+        auto future = p.promise.get_future();
+        bool wasIdle;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(std::move(p));
+            wasIdle = idle;
+        }
+        if (wasIdle)  // Avoid a system call while the I/O thread is busy
+            wake.notify_one();
+        return future;
+    }
+
+    /// Send a value and wait for the reply. Thread-safe.
+    uint32_t call(uint32_t value) { return send(value).get(); }
+
+    Stats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+  private:
+    struct Pending {
+        uint32_t value;
+        std::promise<uint32_t> promise;
+    };
+
+    /// Body of the I/O thread, the only one that touches the shared memory.
+    void run() {
+        std::deque<Pending> batch;  // Taken from `queued`, not sent yet
+        Message messages[CAPACITY];
+        unsigned spins = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                idle = batch.empty() && queued.empty() && inFlight == 0;
+                if (idle)
+                    wake.wait(lock,
+                              [&] { return stopping || !queued.empty(); });
+                idle = false;
+                if (stopping)
+                    return;
+                for (auto &p : queued)
+                    batch.push_back(std::move(p));
+                queued.clear();
+            }
+            size_t sent     = sendBatch(batch, messages);
+            size_t received = receive(messages);
+            if (sent + received > 0) {
+                spins = 0;
+            } else if (++spins < 1'000) {
+                cpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /// Send as much of the batch as there are free slots, with a single index
+    /// update and notification.
+    size_t sendBatch(std::deque<Pending> &batch, Message *messages) {
+        size_t count = 0;
+        for (; count < batch.size() && !freeSlots.empty(); ++count) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            // The slot is selected by the lower bits of the tag, the upper
+            // bits make it unique (and never equal to STOP)
+            uint32_t tag;
+            do
+                tag = slot + CAPACITY * generation++;
+            while (tag == MessageChannel::STOP);
+            tags[slot]      = tag;
+            busy[slot]      = true;
+            promises[slot]  = std::move(batch[count].promise);
+            messages[count] = {tag, batch[count].value};
+        }
+        size_t pushed = channel->linux2baremetal.push(messages, count);
+        // The ring can't be full with at most CAPACITY messages in flight, but
+        // put back anything that didn't fit anyway
+        for (size_t i = count; i-- > pushed;) {
+            uint32_t slot    = messages[i].id % CAPACITY;
+            batch[i].promise = std::move(promises[slot]);
+            busy[slot]       = false;
+            freeSlots.push_back(slot);
+        }
+        batch.erase(batch.begin(), batch.begin() + pushed);
+        if (pushed > 0) {
+            notify(channel->baremetalWaiters, doorbell);
+            inFlight += pushed;
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.messages += pushed;
+            ++stats.batches;
+        }
+        return pushed;
+    }
+
+    /// Complete the futures of all replies that have arrived.
+    size_t receive(Message *messages) {
+        size_t count = channel->baremetal2linux.pop(messages, CAPACITY);
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t slot = messages[i].id % CAPACITY;
+            if (!busy[slot] || tags[slot] != messages[i].id)
+                continue;  // Not ours, e.g. the reply to a STOP
+            promises[slot].set_value(messages[i].value);
+            promises[slot] = {};
+            busy[slot]     = false;
+            freeSlots.push_back(slot);
+            --inFlight;
+        }
+        return count;
+    }
+
+    volatile MessageChannel *channel;
+    Doorbell &doorbell;
+
+    // Shared between the threads
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Pending> queued;
+    bool idle     = false;
+    bool stopping = false;
+    Stats stats   = {};
+
+    // Only used by the I/O thread
+    std::promise<uint32_t> promises[CAPACITY];
+    uint32_t tags[CAPACITY] = {};
+    bool busy[CAPACITY]     = {};
+    std::vector<uint32_t> freeSlots;
+    size_t inFlight     = 0;
+    uint32_t generation = 0;
+
+    std::thread thread;
+};
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <SharedMemConfig.hpp>  // CACHE_LINE_SIZE
+
+#include <atomic>       // atomic, atomic_thread_fence
+#include <cstddef>      // size_t
+#include <cstdint>      // uint32_t, int32_t
+#include <cstring>      // memcpy
+#include <type_traits>  // is_trivially_copyable
+
+/// Key and value of a parameter update. Values are stored as 32-bit words,
+/// see ParameterStore::encode and decode.
+struct ParameterUpdate {
+    uint32_t key;
+    uint32_t value;
+};
+
+/// Parameter that changed since a reader's previous poll.
+struct ParameterChange {
+    uint32_t key;
+    uint32_t index;  ///< For ParameterStore::get without looking up the key
+    uint32_t value;
+};
+
+/**
+ * @brief   Fixed-capacity table of tunable parameters (key/value pairs), with
+ *          a single writer and any number of lock-free readers.
+ *
+ * The writer updates one or more entries as a batch: the version of the
+ * table is odd while a batch is being written, and every entry that changed
+ * gets the new (even) version of the table. Readers never write to the
+ * shared memory:
+ *  - Checking whether anything changed is a single load, getVersion().
+ *  - changedSince() lists the entries that changed since the previous poll,
+ *    as a consistent snapshot: either all or none of the updates of a batch.
+ *  - get() reads a single entry, looked up once with indexOf().
+ *
+ * Keys are never removed. Key 0 marks an empty entry.
+ *
+ * @tparam  N
+ *          The capacity of the table. Must be a power of two.
+ */
+template <size_t N>
+class ParameterStore {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                  "The entries must be lock-free");
+
+  public:
+    constexpr static size_t CAPACITY = N;
+    constexpr static uint32_t EMPTY  = 0;
+
+    ParameterStore() = default;
+    ParameterStore(const ParameterStore &) = delete;
+    ParameterStore &operator=(const ParameterStore &) = delete;
+
+    template <class T>
+    static uint32_t encode(T t) {
+        static_assert(sizeof(T) == sizeof(uint32_t) &&
+                          std::is_trivially_copyable<T>::value,
+                      "Parameters must be 32-bit values");
+        uint32_t value;
+        std::memcpy(&value, &t, sizeof(value));
+        return value;
+    }
+    template <class T>
+    static T decode(uint32_t value) {
+        static_assert(sizeof(T) == sizeof(uint32_t) &&
+                          std::is_trivially_copyable<T>::value,
+                      "Parameters must be 32-bit values");
+        T t;
+        std::memcpy(&t, &value, sizeof(value));
+        return t;
+    }
+
+    /**
+     * @brief   Update several parameters atomically. Writer only.
+     *
+     * @return  False if a key is EMPTY, or if the new keys don't fit in the
+     *          table, in which case none of the updates are applied.
+     */
+    bool update(const ParameterUpdate *updates, size_t count) {
+        size_t inserted = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t key = updates[i].key;
+            if (key == EMPTY)
+                return false;
+            size_t index = probe(key);
+            if (index == N)
+                return false;
+            if (entries[index].key.load(std::memory_order_relaxed) == EMPTY &&
+                !inBatch(key, updates, i))
+                ++inserted;
+        }
+        if (inserted > free)
+            return false;
+        uint32_t v = version.load(std::memory_order_relaxed);
+        version.store(v + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < count; ++i) {
+            Entry &e = entries[probe(updates[i].key)];
+            e.value.store(updates[i].value, std::memory_order_relaxed);
+            e.version.store(v + 2, std::memory_order_relaxed);
+            if (e.key.load(std::memory_order_relaxed) == EMPTY) {
+                e.key.store(updates[i].key, std::memory_order_relaxed);
+                --free;
+            }
+        }
+        version.store(v + 2, std::memory_order_release);
+        return true;
+    }
+
+    /// Update a single parameter. Writer only.
+    bool set(uint32_t key, uint32_t value) {
+        ParameterUpdate u = {key, value};
+        return update(&u, 1);
+    }
+
+    /// Version of the entire table, changes whenever a batch is written (odd
+    /// while writing).
+    uint32_t getVersion() const {
+        return version.load(std::memory_order_acquire);
+    }
+
+    /// Index of the entry with the given key, or N if there is no such key.
+    size_t indexOf(uint32_t key) const {
+        size_t index = probe(key);
+        if (index == N ||
+            entries[index].key.load(std::memory_order_acquire) != key)
+            return N;
+        return index;
+    }
+
+    /// Latest value of the entry with the given index.
+    uint32_t get(size_t index) const {
+        return entries[index].value.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief   Get the entries that changed since the given version, and
+     *          update it. Reader only.
+     *
+     * @param   lastVersion
+     *          Version of the previous successful poll (0 initially). Not
+     *          modified if nothing changed, or if the writer was busy.
+     * @param   changes
+     *          Buffer for up to N changes.
+     * @return  The number of changes. Zero if the writer was busy, just poll
+     *          again later.
+     */
+    size_t changedSince(uint32_t &lastVersion, ParameterChange *changes) const {
+        uint32_t v1 = version.load(std::memory_order_acquire);
+        if (v1 == lastVersion || (v1 & 1))
+            return 0;
+        size_t count = 0;
+        for (size_t i = 0; i < N; ++i) {
+            const Entry &e = entries[i];
+            uint32_t v     = e.version.load(std::memory_order_relaxed);
+            if (int32_t(v - lastVersion) > 0)
+                changes[count++] = {e.key.load(std::memory_order_relaxed),
+                                    uint32_t(i),
+                                    e.value.load(std::memory_order_relaxed)};
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version.load(std::memory_order_relaxed) != v1)
+            return 0;
+        lastVersion = v1;
+        return count;
+    }
+
+    bool update(const ParameterUpdate *updates, size_t count) volatile {
+        return self()->update(updates, count);
+    }
+    bool set(uint32_t key, uint32_t value) volatile {
+        return self()->set(key, value);
+    }
+    uint32_t getVersion() const volatile { return self()->getVersion(); }
+    size_t indexOf(uint32_t key) const volatile {
+        return self()->indexOf(key);
+    }
+    uint32_t get(size_t index) const volatile { return self()->get(index); }
+    size_t changedSince(uint32_t &lastVersion,
+                        ParameterChange *changes) const volatile {
+        return self()->changedSince(lastVersion, changes);
+    }
+
+  private:
+    ParameterStore *self() volatile {
+        return const_cast<ParameterStore *>(this);
+    }
+    const ParameterStore *self() const volatile {
+        return const_cast<const ParameterStore *>(this);
+    }
+
+    /// Whether one of the first `count` updates has the given key, so a new
+    /// key that's updated twice in a batch only takes one entry.
+    static bool inBatch(uint32_t key, const ParameterUpdate *updates,
+                        size_t count) {
+        for (size_t i = 0; i < count; ++i)
+            if (updates[i].key == key)
+                return true;
+        return false;
+    }
+
+    /// Index of the entry with the given key, or of the empty entry where it
+    /// would be inserted, or N if the table is full.
+    size_t probe(uint32_t key) const {
+        size_t start = (key * 2654435761u) & (N - 1);
+        for (size_t i = 0; i < N; ++i) {
+            size_t index = (start + i) & (N - 1);
+            uint32_t k   = entries[index].key.load(std::memory_order_relaxed);
+            if (k == key || k == EMPTY)
+                return index;
+        }
+        return N;
+    }
+
+    struct Entry {
+        std::atomic<uint32_t> key     = {EMPTY};
+        std::atomic<uint32_t> value   = {0};
+        std::atomic<uint32_t> version = {0};
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> version = {0};
+    uint32_t free                                          = N;  // Writer only
+    alignas(CACHE_LINE_SIZE) Entry entries[N];
+};
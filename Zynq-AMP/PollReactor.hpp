@@ -0,0 +1,361 @@
+#pragma once
+
+#ifdef BAREMETAL
+#error "PollReactor.hpp is only available on Linux"
+#endif
+
+#include <CpuUtils.hpp>    // cpuRelax, monotonicMicros, timestampTicks
+#include <SPSCRing.hpp>    // SPSCRing
+#include <SharedWait.hpp>  // SleepDoorbell
+
+#include <atomic>              // atomic
+#include <condition_variable>  // condition_variable
+#include <cstddef>             // size_t
+#include <cstdint>             // uint32_t, uint64_t
+#include <cstring>             // strerror
+#include <exception>           // exception_ptr, current_exception
+#include <functional>          // function
+#include <list>                // list
+#include <memory>              // unique_ptr
+#include <mutex>               // mutex, lock_guard, unique_lock
+#include <stdexcept>           // runtime_error, logic_error
+#include <string>              // string
+#include <thread>              // thread
+#include <utility>             // move
+#include <vector>              // vector
+
+#include <pthread.h>  // pthread_setaffinity_np, pthread_setschedparam
+#include <sched.h>    // cpu_set_t, SCHED_FIFO
+
+/// How the poller thread runs.
+struct PollerConfig {
+    /// Pin the poller to this core (-1 to let the scheduler choose). Use a
+    /// core that is isolated from the scheduler (`isolcpus`), otherwise other
+    /// threads add latency.
+    int cpu = -1;
+    /// SCHED_FIFO priority of the poller (1-99), 0 for normal scheduling.
+    /// Needs CAP_SYS_NICE.
+    int fifoPriority = 0;
+    /// Keep polling without pause for this long after the last event (µs).
+    uint32_t spinUs = 100;
+    /// Once idle, wait this long on the doorbell between passes (µs). 0 never
+    /// parks, which burns the entire core but has the lowest latency.
+    uint32_t parkUs = 50;
+};
+
+/// Service statistics of a single endpoint, see PollReactor::getStats.
+struct EndpointStats {
+    std::string name;
+    uint64_t polls;   ///< Number of times the endpoint was checked
+    uint64_t active;  ///< Polls that found something to do
+    uint64_t events;  ///< Sum of the values returned by the callback
+    uint64_t busyNs;  ///< Time spent in active polls
+    uint64_t maxNs;   ///< Longest active poll
+};
+
+/**
+ * @brief   A single Linux thread that services many shared-memory endpoints,
+ *          instead of one busy-waiting thread per channel.
+ *
+ * Each endpoint is a callback that checks the shared memory (a ring, a flag,
+ * a sequence number, ...), handles whatever it finds, and returns the number
+ * of events it handled. Every pass of the poller calls all endpoints, so all
+ * channels get the latency of polling, for the cost of a single core. Other
+ * threads can block in wait() until a condition in the shared memory holds,
+ * without spinning themselves.
+ *
+ * When no endpoint found anything for `spinUs`, the poller parks: it waits
+ * on the doorbell for up to `parkUs` between passes, until the next event.
+ *
+ * Endpoints are added before start(), and are only called by the poller
+ * thread.
+ *
+ * @tparam  Doorbell
+ *          Doorbell that Baremetal rings when it writes to an endpoint, see
+ *          SharedWait.hpp. SleepDoorbell if there is no interrupt.
+ */
+template <class Doorbell = SleepDoorbell>
+class PollReactor {
+  public:
+    using Callback = std::function<size_t()>;
+
+    PollReactor(Doorbell &doorbell, const PollerConfig &config = {})
+        : doorbell(doorbell), config(config) {}
+    ~PollReactor() { stop(); }
+    PollReactor(const PollReactor &) = delete;
+    PollReactor &operator=(const PollReactor &) = delete;
+
+    /// Add an endpoint. Returns its index for getStats.
+    size_t add(std::string name, Callback poll) {
+        if (thread.joinable())
+            throw std::logic_error("PollReactor: add() after start()");
+        endpoints.push_back(std::make_unique<Endpoint>());
+        endpoints.back()->name = std::move(name);
+        endpoints.back()->poll = std::move(poll);
+        return endpoints.size() - 1;
+    }
+
+    /// Add an endpoint that pops everything from a ring, in batches, and
+    /// calls the handler for each element.
+    template <class T, size_t N, class Handler>
+    size_t addRing(std::string name, volatile SPSCRing<T, N> &ring,
+                   Handler handler) {
+        return add(std::move(name), [&ring, handler]() mutable {
+            T buffer[32];
+            size_t total = 0, count;
+            while ((count = ring.pop(buffer, 32)) > 0) {
+                for (size_t i = 0; i < count; ++i)
+                    handler(buffer[i]);
+                total += count;
+            }
+            return total;
+        });
+    }
+
+    /// Add an endpoint that calls the handler whenever the value returned by
+    /// `read` changes, e.g. a sequence number or a flag.
+    template <class Read, class Handler>
+    size_t addChange(std::string name, Read read, Handler handler) {
+        return add(std::move(name),
+                   [read, handler, last = read()]() mutable -> size_t {
+                       auto value = read();
+                       if (value == last)
+                           return 0;
+                       last = value;
+                       handler(value);
+                       return 1;
+                   });
+    }
+
+    /// Start the poller thread, pinned and with the priority from the
+    /// configuration.
+    void start() {
+        if (thread.joinable())
+            throw std::logic_error("PollReactor: already started");
+        {
+            // stop() leaves it set, a restarted poller must wait again
+            std::lock_guard<std::mutex> lock(mutex);
+            configured = false;
+        }
+        running.store(true, std::memory_order_relaxed);
+        thread = std::thread(&PollReactor::run, this);
+        try {
+            configure(thread.native_handle());
+        } catch (...) {
+            stop();
+            throw;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        configured = true;
+        ready.notify_all();
+    }
+
+    /// Stop and join the poller thread. Waiting threads are woken up.
+    void stop() {
+        if (!thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running.store(false, std::memory_order_relaxed);
+            configured = true;
+            ready.notify_all();
+        }
+        doorbell.ring();
+        thread.join();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Waiter *w : waiters)
+            w->done = true;
+        waiters.clear();
+        numWaiters.store(0, std::memory_order_relaxed);
+        ready.notify_all();
+    }
+
+    /**
+     * @brief   Block the calling thread until the poller sees that the
+     *          condition is true. Thread-safe, don't call it from a callback.
+     *
+     * The poller checks the condition on every pass, after calling the
+     * endpoints, so it may use state that the callbacks update.
+     *
+     * @return  False if the reactor was stopped before the condition held.
+     * @throws  The exception that stopped the poller, if a callback threw
+     *          one.
+     */
+    bool wait(std::function<bool()> condition) {
+        Waiter w;
+        w.condition = std::move(condition);
+        std::unique_lock<std::mutex> lock(mutex);
+        if (running.load(std::memory_order_relaxed)) {
+            waiters.push_back(&w);
+            numWaiters.fetch_add(1, std::memory_order_release);
+            ready.wait(lock, [&] { return w.done; });
+        }
+        if (error)
+            std::rethrow_exception(error);
+        return w.satisfied;
+    }
+
+    size_t size() const { return endpoints.size(); }
+    /// Statistics of an endpoint, thread-safe.
+    EndpointStats getStats(size_t index) const {
+        const Endpoint &e = *endpoints[index];
+        return {
+            e.name,
+            e.polls.load(std::memory_order_relaxed),
+            e.active.load(std::memory_order_relaxed),
+            e.events.load(std::memory_order_relaxed),
+            e.busyNs.load(std::memory_order_relaxed),
+            e.maxNs.load(std::memory_order_relaxed),
+        };
+    }
+    /// Number of passes over all endpoints, and of passes while parked.
+    uint64_t getPasses() const {
+        return passes.load(std::memory_order_relaxed);
+    }
+    uint64_t getParked() const {
+        return parked.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct Endpoint {
+        std::string name;
+        Callback poll;
+        // Only written by the poller thread
+        std::atomic<uint64_t> polls  = {0};
+        std::atomic<uint64_t> active = {0};
+        std::atomic<uint64_t> events = {0};
+        std::atomic<uint64_t> busyNs = {0};
+        std::atomic<uint64_t> maxNs  = {0};
+    };
+
+    struct Waiter {
+        std::function<bool()> condition;
+        bool done      = false;
+        bool satisfied = false;
+    };
+
+    /// Pin the thread and set its scheduling policy.
+    void configure(pthread_t handle) {
+        if (config.cpu >= 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(config.cpu, &cpus);
+            int r = pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+            if (r != 0)
+                throw std::runtime_error(
+                    "PollReactor: pinning to core " +
+                    std::to_string(config.cpu) + " failed (" +
+                    std::strerror(r) + ")");
+        }
+        if (config.fifoPriority > 0) {
+            sched_param param = {};
+            param.sched_priority = config.fifoPriority;
+            int r = pthread_setschedparam(handle, SCHED_FIFO, &param);
+            if (r != 0)
+                throw std::runtime_error(
+                    "PollReactor: SCHED_FIFO priority " +
+                    std::to_string(config.fifoPriority) + " failed (" +
+                    std::strerror(r) + ")");
+        }
+    }
+
+    /// Body of the poller thread. An exception thrown by a callback stops the
+    /// poller.
+    void run() {
+        {
+            // Don't poll before the thread is pinned
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&] { return configured; });
+        }
+        try {
+            poll();
+        } catch (...) {
+            // Stop polling, and let the waiting threads rethrow the exception
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+            running.store(false, std::memory_order_relaxed);
+            for (Waiter *w : waiters)
+                w->done = true;
+            waiters.clear();
+            numWaiters.store(0, std::memory_order_relaxed);
+            ready.notify_all();
+        }
+    }
+
+    /// Poll until stopped, spinning or parking between passes.
+    void poll() {
+        uint64_t lastEvent = monotonicMicros();
+        while (running.load(std::memory_order_relaxed)) {
+            size_t events = pass();
+            if (numWaiters.load(std::memory_order_acquire) > 0)
+                checkWaiters();
+            passes.fetch_add(1, std::memory_order_relaxed);
+            if (events > 0) {
+                lastEvent = monotonicMicros();
+            } else if (config.parkUs == 0 ||
+                       monotonicMicros() - lastEvent < config.spinUs) {
+                cpuRelax();
+            } else {
+                parked.fetch_add(1, std::memory_order_relaxed);
+                doorbell.wait(config.parkUs);
+            }
+        }
+    }
+
+    /// Call every endpoint once. A single timestamp per endpoint measures
+    /// the time spent in each callback.
+    size_t pass() {
+        size_t total   = 0;
+        uint64_t start = timestampTicks();
+        for (auto &e : endpoints) {
+            size_t events = e->poll();
+            uint64_t now  = timestampTicks();
+            e->polls.fetch_add(1, std::memory_order_relaxed);
+            if (events > 0) {
+                uint64_t ns = (now - start) * 1'000'000'000 / TICKS_PER_SECOND;
+                e->active.fetch_add(1, std::memory_order_relaxed);
+                e->events.fetch_add(events, std::memory_order_relaxed);
+                e->busyNs.fetch_add(ns, std::memory_order_relaxed);
+                if (ns > e->maxNs.load(std::memory_order_relaxed))
+                    e->maxNs.store(ns, std::memory_order_relaxed);
+                total += events;
+            }
+            start = now;
+        }
+        return total;
+    }
+
+    /// Wake up the threads whose condition holds.
+    void checkWaiters() {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool woke = false;
+        for (auto it = waiters.begin(); it != waiters.end();) {
+            if ((*it)->condition()) {
+                (*it)->done = (*it)->satisfied = true;
+                it   = waiters.erase(it);
+                woke = true;
+                numWaiters.fetch_sub(1, std::memory_order_relaxed);
+            } else {
+                ++it;
+            }
+        }
+        if (woke)
+            ready.notify_all();
+    }
+
+    Doorbell &doorbell;
+    PollerConfig config;
+    std::vector<std::unique_ptr<Endpoint>> endpoints;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::list<Waiter *> waiters;
+    std::atomic<size_t> numWaiters = {0};
+    bool configured                = false;
+    std::exception_ptr error;
+
+    std::atomic<bool> running    = {false};
+    std::atomic<uint64_t> passes = {0};
+    std::atomic<uint64_t> parked = {0};
+    std::thread thread;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <SPSCRing.hpp>  // SPSCRing
+
+#include <cstddef>      // size_t
+#include <cstdint>      // uint16_t, uint32_t
+#include <cstring>      // memcpy
+#include <type_traits>  // is_trivially_copyable
+
+/// Size of the arguments or result of a remote procedure call.
+constexpr size_t RPC_PAYLOAD_WORDS = 4;
+
+struct RpcRequest {
+    uint32_t id;      ///< Chosen by the client, copied into the response
+    uint16_t method;  ///< `Method::ID`
+    uint16_t reserved;
+    uint32_t payload[RPC_PAYLOAD_WORDS];
+};
+
+enum RpcStatus : uint32_t {
+    RPC_OK             = 0,
+    RPC_UNKNOWN_METHOD = 1,
+};
+
+struct RpcResponse {
+    uint32_t id;
+    uint32_t status;  ///< RpcStatus
+    uint32_t payload[RPC_PAYLOAD_WORDS];
+};
+
+/**
+ * @brief   Request and response rings for remote procedure calls from Linux
+ *          to the bare-metal core.
+ *
+ * Every request gets exactly one response with the same id, but responses
+ * may arrive in any order, so the client can keep many requests in flight
+ * (see RpcClient.hpp). The server is a simple dispatch loop around rpcServe.
+ *
+ * Methods are described by a struct with a unique `ID`, and trivially
+ * copyable `Request` and `Response` types of at most RPC_PAYLOAD_WORDS words:
+ *
+ * ~~~cpp
+ * struct RpcAdd {
+ *     constexpr static uint16_t ID = 1;
+ *     struct Request { uint32_t a, b; };
+ *     using Response = uint32_t;
+ * };
+ * ~~~
+ *
+ * @tparam  N
+ *          The capacity of both rings. Must be a power of two.
+ */
+template <size_t N>
+struct RpcChannel {
+    SPSCRing<RpcRequest, N> requests;    ///< Linux to Baremetal
+    SPSCRing<RpcResponse, N> responses;  ///< Baremetal to Linux
+};
+
+/// Copy a request or response into the payload of a message.
+template <class T>
+void rpcEncode(uint32_t (&payload)[RPC_PAYLOAD_WORDS], const T &t) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "RPC arguments must be trivially copyable");
+    static_assert(sizeof(T) <= sizeof(payload), "RPC arguments too large");
+    std::memcpy(payload, &t, sizeof(T));
+}
+
+/// Copy a request or response out of the payload of a message.
+template <class T>
+T rpcDecode(const uint32_t (&payload)[RPC_PAYLOAD_WORDS]) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "RPC arguments must be trivially copyable");
+    static_assert(sizeof(T) <= sizeof(payload), "RPC arguments too large");
+    T t;
+    std::memcpy(&t, payload, sizeof(T));
+    return t;
+}
+
+/**
+ * @brief   Call `f` if the request is for the given method, and store its
+ *          result in the response.
+ *
+ * Handlers can be chained with `||`, see rpcServe.
+ */
+template <class Method, class F>
+bool rpcDispatch(const RpcRequest &request, RpcResponse &response, F &&f) {
+    if (request.method != Method::ID)
+        return false;
+    using Request = typename Method::Request;
+    rpcEncode(response.payload, typename Method::Response(
+                                    f(rpcDecode<Request>(request.payload))));
+    return true;
+}
+
+/**
+ * @brief   Handle all requests that are currently in the channel, without
+ *          waiting for new ones.
+ *
+ * @param   channel
+ *          The channel to serve.
+ * @param   handler
+ *          Called as `bool handler(const RpcRequest &, RpcResponse &)` for
+ *          each request, returns false for unknown methods, e.g.
+ *          ~~~cpp
+ *          rpcServe(ch, [&](const RpcRequest &req, RpcResponse &resp) {
+ *              return rpcDispatch<RpcAdd>(req, resp, [](auto r) {
+ *                  return r.a + r.b;
+ *              });
+ *          });
+ *          ~~~
+ * @return  The number of requests handled.
+ */
+template <size_t N, class Handler>
+size_t rpcServe(volatile RpcChannel<N> *channel, Handler &&handler) {
+    size_t count = 0;
+    RpcRequest request;
+    while (channel->requests.pop(request)) {
+        RpcResponse response = {request.id, RPC_OK, {}};
+        if (!handler(static_cast<const RpcRequest &>(request), response))
+            response.status = RPC_UNKNOWN_METHOD;
+        // RpcClient never has more than N requests in flight, so there is
+        // always room, but other clients may not be that careful
+        while (!channel->responses.push(response))
+            ;
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#ifndef __cpp_impl_coroutine
+#error "RpcClient.hpp requires C++20 coroutines (-std=c++20, GCC 10 or later)"
+#endif
+
+#include <RpcChannel.hpp>  // RpcChannel, RpcRequest, RpcResponse
+
+#include <coroutine>  // coroutine_handle, suspend_always, suspend_never
+#include <cstddef>    // size_t
+#include <cstdint>    // uint32_t
+#include <deque>      // deque
+#include <exception>  // exception_ptr
+#include <stdexcept>  // runtime_error
+#include <string>     // to_string
+#include <utility>    // exchange
+#include <vector>     // vector
+
+/**
+ * @brief   Coroutine that starts running immediately, and runs until its
+ *          first `co_await` of an RPC that hasn't completed yet.
+ *
+ * Poll the client until the task is done, e.g.
+ * ~~~cpp
+ * RpcTask task = work(client);
+ * while (!task.done())
+ *     client.poll();
+ * task.get(); // rethrows the exception that ended the task, if any
+ * ~~~
+ */
+class RpcTask {
+  public:
+    struct promise_type {
+        std::exception_ptr exception;
+
+        RpcTask get_return_object() {
+            return RpcTask{Handle::from_promise(*this)};
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    RpcTask(RpcTask &&other) : handle(std::exchange(other.handle, {})) {}
+    RpcTask &operator=(RpcTask &&other) {
+        std::swap(handle, other.handle);
+        return *this;
+    }
+    ~RpcTask() {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool done() const { return handle.done(); }
+    void get() const {
+        if (handle.promise().exception)
+            std::rethrow_exception(handle.promise().exception);
+    }
+
+  private:
+    explicit RpcTask(Handle handle) : handle(handle) {}
+    Handle handle;
+};
+
+/**
+ * @brief   Linux side of an RpcChannel, where coroutines can `co_await` the
+ *          responses.
+ *
+ * A single thread can have up to N requests in flight, from any number of
+ * coroutines. Calls beyond that wait in a local queue, so the response ring
+ * can never overflow. Responses can complete in any order: each one resumes
+ * the coroutine that is waiting for it, from within poll().
+ *
+ * Not thread-safe: all calls and polls have to happen on the same thread.
+ */
+template <size_t N>
+class RpcClient {
+    struct CallBase {
+        RpcRequest request;
+        RpcResponse response;
+        std::coroutine_handle<> handle;
+    };
+
+  public:
+    /// Awaitable result of call().
+    template <class Method>
+    class Call : CallBase {
+      public:
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> handle) {
+            this->handle = handle;
+            client.submit(this);
+        }
+        typename Method::Response await_resume() const {
+            if (this->response.status != RPC_OK)
+                throw std::runtime_error(
+                    "RPC " + std::to_string(Method::ID) + " failed with " +
+                    std::to_string(this->response.status));
+            return rpcDecode<typename Method::Response>(
+                this->response.payload);
+        }
+
+      private:
+        friend class RpcClient;
+        Call(RpcClient &client, const typename Method::Request &request)
+            : client(client) {
+            this->request.method = Method::ID;
+            rpcEncode(this->request.payload, request);
+        }
+        RpcClient &client;
+    };
+
+    explicit RpcClient(volatile RpcChannel<N> *channel) : channel(channel) {
+        for (uint32_t slot = 0; slot < N; ++slot)
+            freeSlots.push_back(slot);
+    }
+    RpcClient(const RpcClient &) = delete;
+    RpcClient &operator=(const RpcClient &) = delete;
+
+    /// Call a method on the bare-metal core. The request is sent when the
+    /// result is awaited.
+    template <class Method>
+    Call<Method> call(const typename Method::Request &request) {
+        return {*this, request};
+    }
+
+    /// Send queued requests, and resume the coroutines whose responses have
+    /// arrived. Returns the number of completed calls.
+    size_t poll() {
+        RpcResponse responses[N];
+        std::coroutine_handle<> ready[N];
+        size_t count = channel->responses.pop(responses, N);
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t slot  = responses[i].id % N;
+            CallBase *call = inFlight[slot];
+            if (call == nullptr || call->request.id != responses[i].id)
+                throw std::runtime_error("Unexpected RPC response");
+            call->response = responses[i];
+            inFlight[slot] = nullptr;
+            freeSlots.push_back(slot);
+            ready[i] = call->handle;
+        }
+        send();
+        // Resumed coroutines may start new calls, or even poll themselves
+        for (size_t i = 0; i < count; ++i)
+            ready[i].resume();
+        return count;
+    }
+
+    /// Number of calls that are waiting for a response, sent or not.
+    size_t pending() const { return N - freeSlots.size() + queued.size(); }
+
+  private:
+    void submit(CallBase *call) {
+        queued.push_back(call);
+        send();
+    }
+
+    /// Send as many queued requests as there are free slots and room in the
+    /// request ring. The id of a request selects its slot, the upper bits
+    /// make it unique.
+    void send() {
+        while (!queued.empty() && !freeSlots.empty()) {
+            CallBase *call   = queued.front();
+            uint32_t slot    = freeSlots.back();
+            call->request.id = slot + N * generation;
+            if (!channel->requests.push(call->request))
+                break;
+            ++generation;
+            freeSlots.pop_back();
+            inFlight[slot] = call;
+            queued.pop_front();
+        }
+    }
+
+    volatile RpcChannel<N> *channel;
+    CallBase *inFlight[N] = {};
+    std::vector<uint32_t> freeSlots;
+    std::deque<CallBase *> queued;
+    uint32_t generation = 0;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <SharedMemConfig.hpp>  // CACHE_LINE_SIZE
+
+#include <atomic>       // atomic, memory_order
+#include <cstddef>      // size_t
+#include <cstdint>      // uint32_t
+#include <type_traits>  // is_trivially_copyable
+
+/**
+ * @brief   Lock-free single-producer, single-consumer ring buffer that can be
+ *          placed in the memory that is shared between Linux and bare-metal.
+ *
+ * The producer only writes `head`, the consumer only writes `tail`, and both
+ * live on their own cache line, together with the producer's or consumer's
+ * cached copy of the other index. Elements are published with a release store
+ * of the index and picked up with an acquire load, so no read-modify-write
+ * instructions are needed, and the ring also works in memory without support
+ * for exclusive accesses.
+ *
+ * All member functions have a `volatile` overload, so they can be called
+ * through `BaremetalShared<T>::operator->()`.
+ *
+ * @tparam  T
+ *          The type of the messages. Must be trivially copyable.
+ * @tparam  N
+ *          The capacity of the ring. Must be a power of two.
+ */
+template <class T, size_t N>
+class SPSCRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+    static_assert(N <= (1ul << 31), "N too large for 32-bit indices");
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                  "The ring indices must be lock-free");
+
+  public:
+    SPSCRing() = default;
+    SPSCRing(const SPSCRing &) = delete;
+    SPSCRing &operator=(const SPSCRing &) = delete;
+
+    static constexpr size_t capacity() { return N; }
+
+    /// Append one element. Producer only. Returns false if the ring is full.
+    bool push(const T &t) { return push(&t, 1) == 1; }
+
+    /// Append up to `count` elements, publishing them with a single index
+    /// update. Producer only. Returns the number of elements written.
+    size_t push(const T *data, size_t count) {
+        uint32_t h   = head.load(std::memory_order_relaxed);
+        size_t space = N - (h - producerTail);
+        if (space < count) {  // Only touch the consumer's line if needed
+            producerTail = tail.load(std::memory_order_acquire);
+            space        = N - (h - producerTail);
+        }
+        if (count > space)
+            count = space;
+        for (size_t i = 0; i < count; ++i)
+            buffer[(h + i) & (N - 1)] = data[i];
+        if (count > 0)
+            head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    /// Remove one element. Consumer only. Returns false if the ring is empty.
+    bool pop(T &t) { return pop(&t, 1) == 1; }
+
+    /// Remove up to `count` elements, releasing their slots with a single
+    /// index update. Consumer only. Returns the number of elements read.
+    size_t pop(T *data, size_t count) {
+        uint32_t t   = tail.load(std::memory_order_relaxed);
+        size_t avail = consumerHead - t;
+        if (avail < count) {  // Only touch the producer's line if needed
+            consumerHead = head.load(std::memory_order_acquire);
+            avail        = consumerHead - t;
+        }
+        if (count > avail)
+            count = avail;
+        for (size_t i = 0; i < count; ++i)
+            data[i] = buffer[(t + i) & (N - 1)];
+        if (count > 0)
+            tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    /// Number of elements in the ring. Only exact when called by the producer
+    /// or consumer while the other side is idle.
+    size_t size() const {
+        uint32_t t = tail.load(std::memory_order_acquire);
+        return head.load(std::memory_order_acquire) - t;
+    }
+    bool empty() const { return size() == 0; }
+
+    bool push(const T &t) volatile { return self()->push(t); }
+    size_t push(const T *data, size_t count) volatile {
+        return self()->push(data, count);
+    }
+    bool pop(T &t) volatile { return self()->pop(t); }
+    size_t pop(T *data, size_t count) volatile {
+        return self()->pop(data, count);
+    }
+    size_t size() const volatile { return self()->size(); }
+    bool empty() const volatile { return self()->empty(); }
+
+  private:
+    // The ordering is guaranteed by the atomic indices, the other members
+    // don't have to be volatile.
+    SPSCRing *self() volatile { return const_cast<SPSCRing *>(this); }
+    const SPSCRing *self() const volatile {
+        return const_cast<const SPSCRing *>(this);
+    }
+
+    // Producer's cache line
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> head = {0};
+    uint32_t producerTail = 0;
+    // Consumer's cache line
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> tail = {0};
+    uint32_t consumerHead = 0;
+    // Data
+    alignas(CACHE_LINE_SIZE) T buffer[N];
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <SharedMemConfig.hpp>  // CACHE_LINE_SIZE
+
+#include <atomic>       // atomic, atomic_thread_fence
+#include <cstddef>      // size_t
+#include <cstdint>      // uint32_t
+#include <cstring>      // memcpy
+#include <type_traits>  // is_trivially_copyable
+
+/**
+ * @brief   Publishes snapshots of a struct from one writer to any number of
+ *          readers, using a sequence lock.
+ *
+ * The writer never blocks: it makes the sequence number odd, writes the data
+ * and makes the sequence number even again. Readers copy the data and retry
+ * if the sequence number was odd or changed while copying. Readers never
+ * write to the shared memory, so they don't slow down the writer.
+ *
+ * The data is stored as relaxed atomic words, so concurrent reads of a torn
+ * value are well-defined, they're simply discarded.
+ *
+ * @tparam  T
+ *          The type of the data. Must be trivially copyable.
+ */
+template <class T>
+class alignas(CACHE_LINE_SIZE) SeqlockShared {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                  "The sequence number must be lock-free");
+
+  public:
+    SeqlockShared() = default;
+    SeqlockShared(const SeqlockShared &) = delete;
+    SeqlockShared &operator=(const SeqlockShared &) = delete;
+
+    /// Publish a new value. Only one core may write.
+    void write(const T &t) {
+        uint32_t buffer[NUM_WORDS] = {};
+        std::memcpy(buffer, &t, sizeof(T));
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < NUM_WORDS; ++i)
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    /// Try to read a consistent copy once. Returns false if the writer was
+    /// busy, in which case `t` is not modified.
+    bool tryRead(T &t) const {
+        uint32_t buffer[NUM_WORDS];
+        uint32_t s1 = seq.load(std::memory_order_acquire);
+        if (s1 & 1)
+            return false;
+        for (size_t i = 0; i < NUM_WORDS; ++i)
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) != s1)
+            return false;
+        std::memcpy(&t, buffer, sizeof(T));
+        return true;
+    }
+
+    /// Get a consistent copy of the latest value, retrying on torn reads.
+    T read() const {
+        T t;
+        while (!tryRead(t))
+            ;
+        return t;
+    }
+
+    /// Number of values published so far. Can be used to check for updates
+    /// without copying the data.
+    uint32_t version() const {
+        return seq.load(std::memory_order_acquire) / 2;
+    }
+
+    void write(const T &t) volatile { self()->write(t); }
+    bool tryRead(T &t) const volatile { return self()->tryRead(t); }
+    T read() const volatile { return self()->read(); }
+    uint32_t version() const volatile { return self()->version(); }
+
+  private:
+    SeqlockShared *self() volatile { return const_cast<SeqlockShared *>(this); }
+    const SeqlockShared *self() const volatile {
+        return const_cast<const SeqlockShared *>(this);
+    }
+
+    static constexpr size_t NUM_WORDS =
+        (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> seq              = {0};
+    std::atomic<uint32_t> words[NUM_WORDS] = {};
+};
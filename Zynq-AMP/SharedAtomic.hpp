@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>       // atomic, memory_order
+#include <cstddef>      // size_t
+#include <type_traits>  // is_integral, is_trivially_copyable
+
+/**
+ * @brief   Field of a shared struct that is accessed by both cores, with an
+ *          explicit memory order for every access.
+ *
+ * Unlike `volatile` fields, the accesses are ordered with respect to other
+ * memory accesses, and only the fields that synchronize the cores pay for
+ * barriers: the rest of the struct can be accessed normally, e.g. through
+ * BaremetalShared::view(). There are no defaults for the memory order and no
+ * implicit conversions, so every access shows how it synchronizes.
+ *
+ * The value has to be lock-free in both builds: ARMv7-A has exclusive loads
+ * and stores of 1, 2, 4 and 8 bytes (`ldrexd`/`strexd`), as long as the
+ * value is naturally aligned. A lock in the shared memory would not work
+ * across the cores.
+ *
+ * @tparam  T
+ *          The type of the value, trivially copyable and at most 8 bytes.
+ */
+template <class T>
+class SharedAtomic {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 ||
+                      sizeof(T) == 8,
+                  "ARMv7 only has lock-free atomics of 1, 2, 4 or 8 bytes");
+    static_assert(std::atomic<T>::is_always_lock_free,
+                  "T must be lock-free");
+
+  public:
+    constexpr SharedAtomic(T t = T()) : value(t) {}
+    SharedAtomic(const SharedAtomic &) = delete;
+    SharedAtomic &operator=(const SharedAtomic &) = delete;
+
+    T load(std::memory_order order) const { return value.load(order); }
+    void store(T t, std::memory_order order) { value.store(t, order); }
+    T exchange(T t, std::memory_order order) {
+        return value.exchange(t, order);
+    }
+    bool compare_exchange_weak(T &expected, T desired,
+                               std::memory_order success,
+                               std::memory_order failure) {
+        return value.compare_exchange_weak(expected, desired, success,
+                                           failure);
+    }
+    bool compare_exchange_strong(T &expected, T desired,
+                                 std::memory_order success,
+                                 std::memory_order failure) {
+        return value.compare_exchange_strong(expected, desired, success,
+                                             failure);
+    }
+    template <class U = T>
+    std::enable_if_t<std::is_integral<U>::value, T>
+    fetch_add(T t, std::memory_order order) {
+        return value.fetch_add(t, order);
+    }
+    template <class U = T>
+    std::enable_if_t<std::is_integral<U>::value, T>
+    fetch_sub(T t, std::memory_order order) {
+        return value.fetch_sub(t, order);
+    }
+
+    // Shared structs are often reached through a volatile pointer. The
+    // atomic operations don't need volatile to reach the memory, so these
+    // simply forward to the functions above.
+
+    T load(std::memory_order order) const volatile {
+        return self()->load(order);
+    }
+    void store(T t, std::memory_order order) volatile {
+        self()->store(t, order);
+    }
+    T exchange(T t, std::memory_order order) volatile {
+        return self()->exchange(t, order);
+    }
+    bool compare_exchange_weak(T &expected, T desired,
+                               std::memory_order success,
+                               std::memory_order failure) volatile {
+        return self()->compare_exchange_weak(expected, desired, success,
+                                             failure);
+    }
+    bool compare_exchange_strong(T &expected, T desired,
+                                 std::memory_order success,
+                                 std::memory_order failure) volatile {
+        return self()->compare_exchange_strong(expected, desired, success,
+                                               failure);
+    }
+    template <class U = T>
+    std::enable_if_t<std::is_integral<U>::value, T>
+    fetch_add(T t, std::memory_order order) volatile {
+        return self()->fetch_add(t, order);
+    }
+    template <class U = T>
+    std::enable_if_t<std::is_integral<U>::value, T>
+    fetch_sub(T t, std::memory_order order) volatile {
+        return self()->fetch_sub(t, order);
+    }
+
+  private:
+    SharedAtomic *self() volatile { return const_cast<SharedAtomic *>(this); }
+    const SharedAtomic *self() const volatile {
+        return const_cast<const SharedAtomic *>(this);
+    }
+
+    alignas(sizeof(T)) std::atomic<T> value;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <SharedMemConfig.hpp>  // CACHE_LINE_SIZE
+
+#include <atomic>   // atomic
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+
+/// Small handle to a buffer in a SharedBufferPool, which can be passed to the
+/// other core, e.g. through an SPSCRing, instead of the data itself.
+struct BufferDescriptor {
+    uint32_t index;   ///< Index of the block in the pool
+    uint32_t length;  ///< Number of bytes used
+};
+
+/**
+ * @brief   Fixed-size block allocator in the shared memory, that can be used by
+ *          both cores at the same time.
+ *
+ * The free blocks form a lock-free stack, linked by block index rather than by
+ * pointer, so it works regardless of where each core maps the memory. The
+ * head of the stack carries a tag that is incremented on every update to
+ * prevent the ABA problem.
+ *
+ * Producers allocate a block, fill it in place and pass its BufferDescriptor
+ * to the consumer, which releases the block when it is done with it. The data
+ * itself is never copied.
+ *
+ * @tparam  BlockSize
+ *          The size of each block in bytes.
+ * @tparam  NumBlocks
+ *          The number of blocks in the pool.
+ */
+template <size_t BlockSize, size_t NumBlocks>
+class SharedBufferPool {
+  public:
+    /// Index returned by allocate() if the pool is empty.
+    constexpr static uint32_t NIL = 0xFFFFFFFF;
+
+    static_assert(NumBlocks > 0 && NumBlocks < NIL);
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "The head of the free list must be lock-free");
+
+    SharedBufferPool() {
+        for (uint32_t i = 0; i < NumBlocks; ++i)
+            next[i].store(i + 1 < NumBlocks ? i + 1 : NIL,
+                          std::memory_order_relaxed);
+        head.store(pack(0, 0), std::memory_order_release);
+    }
+    SharedBufferPool(const SharedBufferPool &) = delete;
+    SharedBufferPool &operator=(const SharedBufferPool &) = delete;
+
+    static constexpr size_t blockSize() { return BlockSize; }
+    static constexpr size_t numBlocks() { return NumBlocks; }
+
+    /// Take a free block from the pool. Returns NIL if there are none left.
+    uint32_t allocate() {
+        uint64_t h = head.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t index = indexOf(h);
+            if (index == NIL)
+                return NIL;
+            // If another core popped this block in the meantime, `next` may
+            // be stale, but then the tag has changed and the CAS fails.
+            uint32_t n = next[index].load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(h, pack(n, tagOf(h) + 1),
+                                           std::memory_order_acquire,
+                                           std::memory_order_acquire))
+                return index;
+        }
+    }
+
+    /// Return a block to the pool. Any core may release any block.
+    void release(uint32_t index) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        do {
+            next[index].store(indexOf(h), std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(h, pack(index, tagOf(h) + 1),
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+    }
+
+    /// Get a pointer to the data of the given block.
+    uint8_t *data(uint32_t index) { return blocks[index]; }
+    const uint8_t *data(uint32_t index) const { return blocks[index]; }
+
+    uint32_t allocate() volatile { return self()->allocate(); }
+    void release(uint32_t index) volatile { self()->release(index); }
+    uint8_t *data(uint32_t index) volatile { return self()->data(index); }
+    const uint8_t *data(uint32_t index) const volatile {
+        return self()->data(index);
+    }
+
+  private:
+    static uint64_t pack(uint32_t index, uint32_t tag) {
+        return uint64_t(tag) << 32 | index;
+    }
+    static uint32_t indexOf(uint64_t h) { return uint32_t(h); }
+    static uint32_t tagOf(uint64_t h) { return uint32_t(h >> 32); }
+
+    SharedBufferPool *self() volatile {
+        return const_cast<SharedBufferPool *>(this);
+    }
+    const SharedBufferPool *self() const volatile {
+        return const_cast<const SharedBufferPool *>(this);
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> next[NumBlocks];
+    alignas(CACHE_LINE_SIZE) uint8_t blocks[NumBlocks][BlockSize];
+};
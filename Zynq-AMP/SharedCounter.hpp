@@ -0,0 +1,94 @@
+#pragma once
+
+#include <SharedMemConfig.hpp>  // CACHE_LINE_SIZE, NUM_CORES, THIS_CORE
+
+#include <atomic>   // atomic
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t
+
+/**
+ * @brief   Counter in the shared memory that any number of writers can update
+ *          with an atomic fetch-add, without locking.
+ *
+ * Requires exclusive access (`ldrex`/`strex`) support for the memory it lives
+ * in. Prefer ShardedCounter for statistics that are updated often.
+ */
+class alignas(CACHE_LINE_SIZE) AtomicCounter {
+  public:
+    AtomicCounter() = default;
+    AtomicCounter(const AtomicCounter &) = delete;
+    AtomicCounter &operator=(const AtomicCounter &) = delete;
+
+    /// Add to the counter, returns the previous value.
+    uint32_t add(uint32_t n = 1) {
+        return value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint32_t get() const { return value.load(std::memory_order_relaxed); }
+
+    uint32_t add(uint32_t n = 1) volatile { return self()->add(n); }
+    uint32_t get() const volatile { return self()->get(); }
+
+  private:
+    AtomicCounter *self() volatile { return const_cast<AtomicCounter *>(this); }
+    const AtomicCounter *self() const volatile {
+        return const_cast<const AtomicCounter *>(this);
+    }
+
+    std::atomic<uint32_t> value = {0};
+};
+
+/**
+ * @brief   Counter in the shared memory with one slot per core, each on its
+ *          own cache line, that are summed when reading.
+ *
+ * Every slot has a single writer, so updating it is a plain load and store:
+ * no read-modify-write instructions, no cache line bouncing between cores and
+ * no blocking. Reads are not a snapshot of all slots at the same time.
+ *
+ * @tparam  NumSlots
+ *          The number of writers. Each slot may only be written by one thread.
+ */
+template <size_t NumSlots = NUM_CORES>
+class ShardedCounter {
+  public:
+    ShardedCounter() = default;
+    ShardedCounter(const ShardedCounter &) = delete;
+    ShardedCounter &operator=(const ShardedCounter &) = delete;
+
+    /// Add to the given slot. Only the owner of the slot may call this.
+    void add(uint32_t n = 1, size_t slot = THIS_CORE) {
+        auto &v = slots[slot].value;
+        v.store(v.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+    /// Sum of all slots.
+    uint32_t get() const {
+        uint32_t sum = 0;
+        for (const Slot &s : slots)
+            sum += s.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+    /// Value of a single slot.
+    uint32_t get(size_t slot) const {
+        return slots[slot].value.load(std::memory_order_relaxed);
+    }
+
+    void add(uint32_t n = 1, size_t slot = THIS_CORE) volatile {
+        self()->add(n, slot);
+    }
+    uint32_t get() const volatile { return self()->get(); }
+    uint32_t get(size_t slot) const volatile { return self()->get(slot); }
+
+  private:
+    ShardedCounter *self() volatile {
+        return const_cast<ShardedCounter *>(this);
+    }
+    const ShardedCounter *self() const volatile {
+        return const_cast<const ShardedCounter *>(this);
+    }
+
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<uint32_t> value = {0};
+    };
+    Slot slots[NumSlots];
+};
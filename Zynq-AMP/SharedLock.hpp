@@ -0,0 +1,162 @@
+#pragma once
+
+#include <CpuUtils.hpp>  // cpuRelax, monotonicMicros
+
+#include <algorithm>    // min
+#include <atomic>       // atomic
+#include <cstdint>      // uint32_t, uint64_t
+#include <stdexcept>    // runtime_error
+#include <type_traits>  // conditional_t
+#ifdef BAREMETAL
+#include <ps7_cortexa9_1/include/sleep.h>
+#else
+#include <unistd.h>
+#endif
+
+// ================================== LOCK ================================== //
+
+/// How to wait for a lock.
+struct LockConfig {
+    /// Number of times to spin with cpuRelax() before backing off.
+    uint32_t spins = 1'000;
+    /// Upper bound for the exponential backoff sleep (µs).
+    uint32_t maxBackoffUs = 64;
+    /// Throw if the lock cannot be acquired within this time (µs).
+    uint32_t timeoutUs = 10'000;
+};
+
+/// Contention counters, only updated while holding the lock.
+struct LockStats {
+    uint32_t acquisitions = 0;  ///< Total number of times the lock was taken
+    uint32_t contended    = 0;  ///< Number of times we had to wait
+    uint32_t spins        = 0;  ///< Total number of wait iterations
+    uint32_t maxWaitUs    = 0;  ///< Longest time a core had to wait
+};
+
+/**
+ * @brief   Fair (first come, first served) lock that can be shared between the
+ *          Linux and bare-metal cores.
+ *
+ * Waiters take a ticket and wait until it's being served. They first spin for
+ * a short time, and then sleep with an exponentially increasing delay.
+ *
+ * If the lock cannot be acquired within the timeout, the waiter withdraws its
+ * ticket and throws. A ticket can only be withdrawn if no other waiters queued
+ * up behind it (always the case with one thread per core), otherwise leaving
+ * would block them forever, so the waiter keeps waiting.
+ *
+ * @tparam  WithStats
+ *          Keep contention counters (see LockStats) in the lock.
+ */
+template <bool WithStats = false>
+class TicketLock {
+  public:
+    TicketLock() = default;
+    TicketLock(const TicketLock &) = delete;
+    TicketLock &operator=(const TicketLock &) = delete;
+
+    void lock(const LockConfig &config = {}) {
+        uint32_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+        if (serving.load(std::memory_order_acquire) == ticket)
+            acquired(0, 0);
+        else
+            wait(ticket, config);
+    }
+
+    bool try_lock() {
+        // Acquire, to synchronize with the previous owner's unlock()
+        uint32_t ticket = serving.load(std::memory_order_acquire);
+        if (!next.compare_exchange_strong(ticket, ticket + 1,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed))
+            return false;
+        acquired(0, 0);
+        return true;
+    }
+
+    void unlock() {
+        // Only the owner writes to `serving`
+        uint32_t s = serving.load(std::memory_order_relaxed);
+        serving.store(s + 1, std::memory_order_release);
+    }
+
+    /// Copy of the contention counters (only consistent when called by the
+    /// owner of the lock).
+    template <bool Enable = WithStats>
+    std::enable_if_t<Enable, LockStats> getStats() const {
+        return stats;
+    }
+
+    void lock(const LockConfig &config = {}) volatile { self()->lock(config); }
+    bool try_lock() volatile { return self()->try_lock(); }
+    void unlock() volatile { self()->unlock(); }
+    template <bool Enable = WithStats>
+    std::enable_if_t<Enable, LockStats> getStats() const volatile {
+        return self()->getStats();
+    }
+
+  private:
+    void wait(uint32_t ticket, const LockConfig &config) {
+        uint64_t start = monotonicMicros();
+        uint32_t spins = 0, delay = 1;
+        while (serving.load(std::memory_order_acquire) != ticket) {
+            ++spins;
+            if (spins <= config.spins) {
+                cpuRelax();
+                continue;
+            }
+            if (monotonicMicros() - start >= config.timeoutUs &&
+                withdraw(ticket))
+                throw std::runtime_error("Timeout: Could not acquire lock");
+            usleep(delay);
+            delay = std::min(2 * delay, config.maxBackoffUs);
+        }
+        acquired(spins, monotonicMicros() - start);
+    }
+
+    /// Give back our ticket, only possible if nobody took a ticket after us.
+    /// If the lock was handed to us in the meantime, withdrawing the ticket
+    /// releases it again.
+    bool withdraw(uint32_t ticket) {
+        uint32_t expected = ticket + 1;
+        return next.compare_exchange_strong(expected, ticket,
+                                            std::memory_order_relaxed);
+    }
+
+    void acquired(uint32_t spins, uint64_t waitUs) {
+        if constexpr (WithStats) {
+            ++stats.acquisitions;
+            stats.contended += spins > 0;
+            stats.spins += spins;
+            if (waitUs > stats.maxWaitUs)
+                stats.maxWaitUs = waitUs;
+        }
+    }
+
+    TicketLock *self() volatile { return const_cast<TicketLock *>(this); }
+    const TicketLock *self() const volatile {
+        return const_cast<const TicketLock *>(this);
+    }
+
+    struct NoStats {};
+
+    std::atomic<uint32_t> next    = {0};  ///< Next ticket to hand out
+    std::atomic<uint32_t> serving = {0};  ///< Ticket that owns the lock
+    std::conditional_t<WithStats, LockStats, NoStats> stats;
+};
+
+template <class Lock>
+class ScopedLock {
+  public:
+    ScopedLock(volatile Lock &lock, const LockConfig &config = {})
+        : lock{lock} {
+        lock.lock(config);
+    }
+    ~ScopedLock() { lock.unlock(); }
+
+    ScopedLock(const ScopedLock &) = delete;
+    ScopedLock &operator=(const ScopedLock &) = delete;
+
+  private:
+    volatile Lock &lock;
+};
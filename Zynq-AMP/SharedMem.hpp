@@ -1,31 +1,67 @@
 #pragma once
 
 #include <ANSIColors.hpp>
+#include <BurstCopy.hpp>        // sharedSnapshot, sharedCommit
+#include <SharedMemConfig.hpp>  // SHARED_MEM_START_ADDRESS
+#include <SharedMemLayout.hpp>  // sharedAddress
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 
 #include <cassert>
 #include <cerrno>
 #include <fcntl.h>
+#include <sstream>
+#include <stdexcept>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <utility>
 
 const size_t PAGE_SIZE      = getpagesize();
 const uintptr_t PAGE_MASK   = ~((uintptr_t) PAGE_SIZE - 1);
 const uintptr_t OFFSET_MASK = (uintptr_t) PAGE_SIZE - 1;
 
+/// Size of the entire shared memory window.
+constexpr size_t SHARED_MEM_SIZE =
+    SHARED_MEM_LAST_ADDRESS - SHARED_MEM_START_ADDRESS + 1;
+
+/// Where the shared memory window comes from.
+enum class SharedMemBackend {
+    /// The physical on-chip memory, through `/dev/mem` (Zynq only).
+    DevMem,
+    /// A named POSIX shared memory object (`shm_open`), so unrelated processes
+    /// can stand in for the bare-metal core.
+    SharedMemoryObject,
+    /// An anonymous memory file (`memfd_create`), shared with child processes
+    /// that are forked after the memory is mapped.
+    Memfd,
+    /// A regular file.
+    File,
+};
+
+/**
+ * @brief   Maps the entire shared memory window into the address space of the
+ *          program when the first instance is created, and unmaps it when the
+ *          last instance is destroyed.
+ *
+ * All users of the shared memory share this single mapping, so there's only
+ * one `mmap` call, and structs can be of any size and cross page boundaries.
+ */
 class SharedMemReferenceCounter {
   public:
     SharedMemReferenceCounter() {
+        std::lock_guard<std::mutex> lock(mutex);
         if (count == 0)  // If this is the first instance
             openMem();   // the memory has to be opened
         ++count;
     }
     ~SharedMemReferenceCounter() {
+        std::lock_guard<std::mutex> lock(mutex);
         --count;
         if (count == 0)  // If this was the last instance
             closeMem();  // the memory has to be closed
@@ -35,89 +71,161 @@ class SharedMemReferenceCounter {
     SharedMemReferenceCounter &
     operator=(const SharedMemReferenceCounter &) = delete;
 
-    int getFileDescriptor() const { return mem_fd; }
+    /**
+     * @brief   Select where the shared memory window comes from. Must be called
+     *          before the memory is mapped, the default is `/dev/mem`.
+     *
+     * @param   backend
+     *          The type of backing store.
+     * @param   name
+     *          The name of the shared memory object (e.g. `"/zynq-amp"`) or
+     *          the path of the file. Ignored for `DevMem` and `Memfd`.
+     */
+    static void setBackend(SharedMemBackend backend, std::string name = "") {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count != 0)
+            throw std::logic_error("Shared memory is already mapped");
+        SharedMemReferenceCounter::backend = backend;
+        SharedMemReferenceCounter::name    = std::move(name);
+    }
+
+    /// Get the virtual address of the given physical address in the shared
+    /// memory window. The mapping doesn't change while this instance exists,
+    /// so no lock is needed.
+    volatile void *getAddress(uintptr_t address) const {
+        assert(address >= SHARED_MEM_START_ADDRESS);
+        assert(address <= SHARED_MEM_LAST_ADDRESS);
+        uintptr_t memp = reinterpret_cast<uintptr_t>(mem);
+        return reinterpret_cast<volatile void *>(
+            memp + (address - SHARED_MEM_START_ADDRESS));
+    }
 
   private:
+    [[noreturn]] static void fail(const std::string &what, int err) {
+        std::ostringstream oss;
+        oss << what << " failed (" << err << ")";
+        std::cerr << ANSIColors::redb << oss.str() << ANSIColors::reset
+                  << std::endl;
+        throw std::runtime_error(oss.str());
+    }
+
+    /// Open the backing store, and return the file descriptor and the offset
+    /// of the shared memory window in that file.
+    static std::pair<int, off_t> openBackend() {
+        int fd = -1;
+        switch (backend) {
+            case SharedMemBackend::DevMem:
+                fd = open("/dev/mem", O_RDWR | O_SYNC);
+                if (fd < 0)
+                    fail("open(/dev/mem)", errno);
+                return {fd, SHARED_MEM_START_ADDRESS};
+            case SharedMemBackend::SharedMemoryObject:
+                fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+                if (fd < 0)
+                    fail("shm_open(" + name + ")", errno);
+                break;
+            case SharedMemBackend::Memfd:
+                fd = memfd_create("BaremetalShared", 0);
+                if (fd < 0)
+                    fail("memfd_create", errno);
+                break;
+            case SharedMemBackend::File:
+                fd = open(name.c_str(), O_RDWR | O_CREAT, 0600);
+                if (fd < 0)
+                    fail("open(" + name + ")", errno);
+                break;
+        }
+        // Other backends start at offset zero, make sure they're large enough
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (st.st_size < off_t(SHARED_MEM_SIZE) &&
+                                   ftruncate(fd, SHARED_MEM_SIZE) < 0)) {
+            int err = errno;
+            close(fd);
+            fail("ftruncate", err);
+        }
+        return {fd, 0};
+    }
+
     void openMem() {
-        mem_fd = open(       //
-            "/dev/mem",      // file path
-            O_RDWR | O_SYNC  // flags
+        // Offset should be aligned to a page, and size should be a multiple
+        // of the page size.
+        assert((SHARED_MEM_START_ADDRESS & OFFSET_MASK) == 0);
+        assert((SHARED_MEM_SIZE & OFFSET_MASK) == 0);
+
+        auto [mem_fd, offset] = openBackend();
+
+        // Map the shared memory region into the virtual address space of the
+        // program.
+        mem = mmap(                  //
+            nullptr,                 // address
+            SHARED_MEM_SIZE,         // length
+            PROT_READ | PROT_WRITE,  // protection
+            MAP_SHARED,              // flags
+            mem_fd,                  // file descriptor
+            offset                   // offset
         );
-        if (mem_fd < 0) {
-            std::cerr << ANSIColors::redb << "open(/dev/mem) failed (" << errno
-                      << ")" << ANSIColors::reset << std::endl;
+        int mmap_errno = errno;
+        close(mem_fd);  // The mapping stays valid after closing the file
+        if (mem == MAP_FAILED) {
             std::ostringstream oss;
-            oss << "open(/dev/mem) failed (" << errno << ")";
-            throw std::runtime_error(oss.str());
+            oss << "mmap(" << std::hex << std::showbase << offset << std::dec
+                << std::noshowbase << ")";
+            fail(oss.str(), mmap_errno);
         }
     }
 
-    void closeMem() { close(mem_fd); }
+    void closeMem() { munmap(mem, SHARED_MEM_SIZE); }
 
-    static size_t count;
-    static int mem_fd;
+    /// Instances can be created and destroyed by any thread.
+    inline static std::mutex mutex         = {};
+    inline static size_t count             = 0;
+    inline static void *mem                = nullptr;
+    inline static SharedMemBackend backend = SharedMemBackend::DevMem;
+    inline static std::string name         = {};
 };
 
+/**
+ * @brief   Typed view of a struct in the shared memory window.
+ *
+ * @tparam  T
+ *          The type of the struct. `sharedAddress<T>` is the physical address
+ *          of the struct (see SharedMemLayout.hpp), the entire struct has to
+ *          lie within the shared memory window.
+ */
 template <class T>
 class BaremetalShared {
-  public:
-    BaremetalShared() {
-        // Get the base address of the page, and the offset within the page.
-        uintptr_t base   = T::address & PAGE_MASK;
-        uintptr_t offset = T::address & OFFSET_MASK;
-        // Make sure we don't cross the page boundary
-        assert(offset + sizeof(T) <= PAGE_SIZE);
-
-        std::cout << std::hex << std::showbase << "T::address = " << T::address
-                  << ", base = " << base << ", offset = " << offset
-                  << ", PAGE_SIZE = " << PAGE_SIZE
-                  << ", PAGE_MASK = " << PAGE_MASK << std::dec
-                  << std::noshowbase << std::endl;
-
-        // Map the hardware address of the shared memory region into the virtual
-        // address space of the program.
-        // Offset should be aligned to a page, and size should be a multiple of
-        // the page size.
-        memmap = mmap(                      //
-            nullptr,                        // address
-            PAGE_SIZE,                      // length
-            PROT_READ | PROT_WRITE,         // protection
-            MAP_SHARED,                     // flags
-            sharedMem.getFileDescriptor(),  // file descriptor
-            base                            // offset
-        );
-        if (memmap == MAP_FAILED) {
-            std::ostringstream oss;
-            oss << "mmap(" << std::hex << std::showbase << base << std::dec
-                << std::noshowbase << ") failed (" << errno << ")";
-            std::cerr << ANSIColors::redb << "mmap(" << std::hex
-                      << std::showbase << base << std::dec << std::noshowbase
-                      << ") failed (" << errno << ")" << ANSIColors::reset
-                      << std::endl;
-            throw std::runtime_error(oss.str());
-        }
-        uintptr_t memmapp = reinterpret_cast<uintptr_t>(memmap);
-        structdata        = reinterpret_cast<volatile T *>(memmapp + offset);
+    static_assert(sharedAddress<T> >= SHARED_MEM_START_ADDRESS);
+    static_assert(sharedAddress<T> <= SHARED_MEM_LAST_ADDRESS - sizeof(T) + 1);
 
-        std::cout << std::hex << std::showbase << "memmap = " << memmap
-                  << std::endl;
-        for (size_t i = 0; i < sizeof(T); ++i) {
-            int data = reinterpret_cast<volatile uint8_t *>(structdata)[i];
-            std::cout << data << " ";
-        }
-        std::cout << std::dec << std::noshowbase << std::endl;
-    }
+  public:
+    BaremetalShared()
+        : structdata{reinterpret_cast<volatile T *>(
+              sharedMem.getAddress(sharedAddress<T>))} {}
 
     BaremetalShared(const BaremetalShared &) = delete;
     BaremetalShared &operator=(const BaremetalShared &) = delete;
 
-    ~BaremetalShared() { munmap(memmap, PAGE_SIZE); }
-
     volatile T *ptr() { return structdata; }
     volatile T *operator->() { return structdata; }
 
+    /// Non-volatile view of the struct. Only for structs where every field
+    /// that the other core accesses concurrently is atomic (e.g. a
+    /// SharedAtomic), so the compiler can optimize all other accesses.
+    T &view() { return *const_cast<T *>(structdata); }
+
+    /// Copy the entire struct into a local, non-volatile one, using the widest
+    /// available loads instead of one access per field. T must be trivially
+    /// copyable.
+    T snapshot() const { return sharedSnapshot(*structdata); }
+
+    /// Write the fields that were changed in `local` since the snapshot `base`
+    /// back to the shared memory, in bursts. Returns the number of bursts
+    /// written. See sharedCommit.
+    size_t commit(const T &local, const T &base) {
+        return sharedCommit(*structdata, local, base);
+    }
+
   private:
-    volatile T *structdata;
-    void *memmap;
     SharedMemReferenceCounter sharedMem;
-};
\ No newline at end of file
+    volatile T *structdata;
+};
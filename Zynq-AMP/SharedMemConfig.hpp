@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uintptr_t
+
+// Physical address range of the on-chip memory (OCM) that is shared between
+// the Linux core and the bare-metal core.
+constexpr uintptr_t SHARED_MEM_START_ADDRESS = 0xFFFF0000;
+constexpr uintptr_t SHARED_MEM_LAST_ADDRESS  = 0xFFFFFFFF;
+
+// Size of a cache line. Data written by different cores should never share a
+// cache line (L1 and L2 of the Cortex-A9 both use 32-byte lines).
+#if defined(__arm__)
+constexpr size_t CACHE_LINE_SIZE = 32;
+#else
+constexpr size_t CACHE_LINE_SIZE = 64;
+#endif
+
+// The cores that share the memory, e.g. to index per-core data.
+enum Core : size_t {
+    LINUX_CORE     = 0,
+    BAREMETAL_CORE = 1,
+    NUM_CORES      = 2,
+};
+
+#ifdef BAREMETAL
+constexpr Core THIS_CORE = BAREMETAL_CORE;
+#else
+constexpr Core THIS_CORE = LINUX_CORE;
+#endif
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <SharedMemConfig.hpp>  // SHARED_MEM_*_ADDRESS, CACHE_LINE_SIZE
+
+#include <cstddef>      // size_t
+#include <cstdint>      // uintptr_t, uint64_t
+#include <new>          // placement new
+#include <type_traits>  // is_same, void_t
+
+/// Checks whether a shared struct has a hardcoded `T::address`.
+template <class T, class = void>
+struct HasFixedAddress : std::false_type {};
+template <class T>
+struct HasFixedAddress<T, std::void_t<decltype(T::address)>>
+    : std::true_type {};
+
+/**
+ * @brief   Assigns addresses in the shared memory window to a list of shared
+ *          structs at compile time.
+ *
+ * The structs are placed in the order they are listed, starting at `Start`.
+ * Each one starts on a cache line boundary and is padded to a whole number of
+ * cache lines, so structs written by different cores never share a line.
+ * Structs with a hardcoded `T::address` stay at that address, but it has to
+ * be aligned to a cache line and must not overlap with the structs before it.
+ * Layouts that overlap or don't fit in the window are rejected by
+ * `static_assert`.
+ *
+ * Register a layout by specializing SharedMemAddress for its types (see
+ * SharedStructs.hpp), so BaremetalShared and initShared can use it.
+ */
+template <uintptr_t Start, class... Ts>
+class SharedMemLayout {
+    constexpr static size_t N = sizeof...(Ts);
+
+    static constexpr uint64_t roundUp(uint64_t n, uint64_t align) {
+        return (n + align - 1) / align * align;
+    }
+    template <class T>
+    static constexpr uintptr_t fixedAddress() {
+        if constexpr (HasFixedAddress<T>::value)
+            return T::address;
+        else
+            return 0;
+    }
+
+    /// Computed in 64 bits, so layouts that run past the end of the 32-bit
+    /// address space don't wrap around.
+    struct Placement {
+        uint64_t addresses[N ? N : 1] = {};
+        uint64_t end                  = Start;
+        bool aligned                   = true;
+        bool overlapping               = false;
+    };
+
+    static constexpr Placement place() {
+        constexpr size_t sizes[]      = {sizeof(Ts)...};
+        constexpr size_t alignments[] = {alignof(Ts)...};
+        constexpr bool fixed[]        = {HasFixedAddress<Ts>::value...};
+        constexpr uintptr_t fixedAddresses[] = {fixedAddress<Ts>()...};
+        Placement p;
+        for (size_t i = 0; i < N; ++i) {
+            size_t align = alignments[i] > CACHE_LINE_SIZE ? alignments[i]
+                                                           : CACHE_LINE_SIZE;
+            uint64_t address = roundUp(p.end, align);
+            if (fixed[i]) {
+                p.aligned &= fixedAddresses[i] % align == 0;
+                p.overlapping |= fixedAddresses[i] < p.end;
+                address = fixedAddresses[i];
+            }
+            p.addresses[i] = address;
+            p.end          = address + roundUp(sizes[i], CACHE_LINE_SIZE);
+        }
+        return p;
+    }
+
+    static constexpr Placement placement = place();
+
+    template <class T>
+    static constexpr size_t count() {
+        return (size_t(0) + ... + size_t(std::is_same<T, Ts>::value));
+    }
+    template <class T>
+    static constexpr size_t indexOf() {
+        size_t i = 0, index = N;
+        ((std::is_same<T, Ts>::value ? index = i : 0, ++i), ...);
+        return index;
+    }
+
+    static_assert(((count<Ts>() == 1) && ...),
+                  "Shared structs can only be listed once");
+    static_assert(Start >= SHARED_MEM_START_ADDRESS,
+                  "Layout starts before the shared memory window");
+    static_assert(placement.aligned,
+                  "Fixed address of a shared struct is not aligned to a cache "
+                  "line");
+    static_assert(!placement.overlapping, "Shared structs overlap");
+    static_assert(placement.end <= uint64_t(SHARED_MEM_LAST_ADDRESS) + 1,
+                  "Shared structs don't fit in the shared memory window");
+
+  public:
+    template <class T>
+    constexpr static bool contains = count<T>() > 0;
+
+    /// Address assigned to the given struct.
+    template <class T>
+    static constexpr uintptr_t addressOf() {
+        static_assert(contains<T>, "Struct is not part of this layout");
+        return uintptr_t(placement.addresses[indexOf<T>()]);
+    }
+
+    /// First address after the last struct.
+    static constexpr uint64_t end() { return placement.end; }
+};
+
+/// Physical address of a shared struct: `T::address` unless a layout assigns
+/// one by specializing this template.
+template <class T, class = void>
+struct SharedMemAddress {
+    constexpr static uintptr_t value = T::address;
+};
+
+template <class T>
+constexpr uintptr_t sharedAddress = SharedMemAddress<T>::value;
+
+/// Construct a shared struct in place. Only Baremetal (or a process standing
+/// in for it) can initialize the shared memory, so shared structs have a
+/// private constructor and befriend this function.
+template <class T>
+volatile T *initAt(volatile void *mem) {
+    return new (const_cast<void *>(mem)) T();
+}
+
+#ifdef BAREMETAL
+/// Construct a shared struct at its address.
+template <class T>
+volatile T *initShared() {
+    static_assert(sharedAddress<T> >= SHARED_MEM_START_ADDRESS);
+    static_assert(sharedAddress<T> <= SHARED_MEM_LAST_ADDRESS - sizeof(T) + 1);
+    return initAt<T>((void *) sharedAddress<T>);
+}
+#endif
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <LatencyHistogram.hpp>  // LatencyHistogram
+#include <ParameterStore.hpp>    // ParameterStore
+#include <RpcChannel.hpp>        // RpcChannel
+#include <SPSCRing.hpp>          // SPSCRing
+#include <SeqlockShared.hpp>     // SeqlockShared
+#include <SharedAtomic.hpp>      // SharedAtomic
+#include <SharedBufferPool.hpp>  // SharedBufferPool, BufferDescriptor
+#include <SharedCounter.hpp>     // ShardedCounter, AtomicCounter
+#include <SharedLock.hpp>        // TicketLock, ScopedLock
+#include <SharedMemConfig.hpp>   // SHARED_MEM_START_ADDRESS
+#include <SharedMemLayout.hpp>   // SharedMemLayout, SharedMemAddress, initAt
+#include <SharedWait.hpp>        // WaitQueue
+#include <TraceRing.hpp>         // TraceRing, TRACE_SYNC
+#include <TripleBuffer.hpp>      // TripleBuffer
+
+#include <cstdint>      // uint32_t
+#include <type_traits>  // enable_if_t
+#ifdef BAREMETAL
+#include <ps7_cortexa9_1/include/sleep.h>
+#else
+#include <unistd.h>
+#endif
+
+// ============================== TEST STRUCT =============================== //
+
+struct TestStruct {
+  private:
+    ShardedCounter<NUM_CORES> counter;
+
+  public:
+    /// Release stores publish the test values, acquire loads pick them up.
+    SharedAtomic<uint32_t> ack = {0};
+    /// Stored (with release) at the end of the constructor.
+    SharedAtomic<uint32_t> magic = {0};
+
+    // Members written by only one of the cores get their own cache line. The
+    // test values are ordered by `ack`, so they can be relaxed.
+    alignas(CACHE_LINE_SIZE) SharedAtomic<uint32_t> testLinux2Baremetal;
+    WaitQueue linuxWaiters;  ///< Linux waiting for `ack` to change
+    alignas(CACHE_LINE_SIZE) SharedAtomic<uint32_t> testBaremetal2Linux;
+    WaitQueue baremetalWaiters;  ///< Baremetal waiting for `ack` to change
+
+    constexpr static uint32_t MAGIC = 0xAA55AA55;
+
+    /// Each core increments its own slot, so no updates are lost and neither
+    /// core ever waits for the other.
+    void increment(Core core = THIS_CORE) volatile {
+        counter.add(1, core);
+        usleep(10);
+    }
+
+    uint32_t getCounter() const volatile { return counter.get(); }
+
+  private:
+    friend volatile TestStruct *initAt<TestStruct>(volatile void *);
+    /// Publishes `magic` once all members are constructed.
+    TestStruct() { magic.store(MAGIC, std::memory_order_release); }
+};
+
+// =============================== COUNTERS ================================= //
+
+/// The same count kept in three ways, to compare what an increment costs when
+/// both cores update it at the same time, see ipc_bench.cpp.
+struct CounterStruct {
+    alignas(CACHE_LINE_SIZE) TicketLock<true> lock;
+    uint32_t locked = 0;  ///< Protected by `lock`
+    AtomicCounter atomic;
+    ShardedCounter<NUM_CORES> sharded;
+    /// Number of times a core arrived at a barrier, see ipc_bench.cpp.
+    alignas(CACHE_LINE_SIZE) SharedAtomic<uint32_t> arrived = {0};
+
+    /// Read-modify-write of plain memory, under the lock.
+    void addLocked(const LockConfig &config = {}) volatile {
+        ScopedLock<TicketLock<true>> guard(lock, config);
+        locked = locked + 1;
+    }
+
+  private:
+    friend volatile CounterStruct *initAt<CounterStruct>(volatile void *);
+    CounterStruct() = default;
+};
+
+// ============================ MESSAGE CHANNEL ============================= //
+
+struct Message {
+    uint32_t id;
+    uint32_t value;
+};
+
+/// One lock-free ring per direction, so both sides can stream messages without
+/// waiting for an acknowledgement of each message.
+struct MessageChannel {
+    SPSCRing<Message, 64> linux2baremetal;
+    SPSCRing<Message, 64> baremetal2linux;
+    WaitQueue baremetalWaiters;  ///< Baremetal waiting for `linux2baremetal`
+
+    constexpr static uint32_t STOP = 0xFFFFFFFF;
+
+  private:
+    friend volatile MessageChannel *initAt<MessageChannel>(volatile void *);
+    MessageChannel() = default;
+};
+
+// =============================== TELEMETRY ================================ //
+
+/// State published by the bare-metal core.
+struct Telemetry {
+    uint32_t iteration;
+    uint32_t counter;
+    uint32_t samples[8];
+};
+
+/// Linux readers always get a consistent copy of the latest telemetry, without
+/// ever blocking the bare-metal writer.
+struct TelemetryStruct {
+    SeqlockShared<Telemetry> telemetry;
+
+  private:
+    friend volatile TelemetryStruct *initAt<TelemetryStruct>(volatile void *);
+    TelemetryStruct() = default;
+};
+
+// ================================ LATENCY ================================= //
+
+/// Latency histograms, one per core, so each has a single writer. They can be
+/// monitored by latency_monitor.cpp while the system is running.
+struct LatencyStruct {
+    LatencyHistogram<> histograms[NUM_CORES];
+
+  private:
+    friend volatile LatencyStruct *initAt<LatencyStruct>(volatile void *);
+    LatencyStruct() = default;
+};
+
+// ================================= FRAMES ================================= //
+
+/// Large frames are filled in place in the pool, only their descriptors are
+/// sent to Linux, which releases the blocks when it's done with them.
+struct FrameExchange {
+    SharedBufferPool<1024, 16> pool;
+    SPSCRing<BufferDescriptor, 16> baremetal2linux;
+
+  private:
+    friend volatile FrameExchange *initAt<FrameExchange>(volatile void *);
+    FrameExchange() = default;
+};
+
+// ================================ CONTROL ================================= //
+
+/// Large frame, sent by Linux every control cycle.
+struct ControlFrame {
+    uint32_t cycle;
+    uint32_t setpoints[255];
+};
+
+/// Baremetal always gets the newest complete control frame, and Linux never
+/// waits for it, so both can run at their own rates.
+struct ControlStruct {
+    TripleBuffer<ControlFrame> frames;
+
+  private:
+    friend volatile ControlStruct *initAt<ControlStruct>(volatile void *);
+    ControlStruct() = default;
+};
+
+// =============================== SETTINGS ================================= //
+
+/// Configuration with many fields, written by Linux and read by Baremetal.
+/// Trivially copyable, so it can be copied with BaremetalShared::snapshot()
+/// and written back with commit(), in bursts instead of one access per field.
+struct SettingsStruct {
+    uint32_t sampleRate;
+    uint32_t decimation;
+    int32_t gains[16];
+    int32_t offsets[16];
+    uint32_t thresholds[16];
+    uint32_t flags;
+
+  private:
+    friend volatile SettingsStruct *initAt<SettingsStruct>(volatile void *);
+    SettingsStruct() = default;
+};
+
+// ============================== PARAMETERS ================================ //
+
+/// Keys of the tunable parameters in ParameterStruct.
+enum Parameter : uint32_t {
+    PARAM_GAIN = 1,  ///< float
+    PARAM_OFFSET,    ///< float
+    PARAM_LIMIT,     ///< uint32_t
+    PARAM_MODE,      ///< uint32_t
+};
+
+/// Parameters that Linux tunes while Baremetal is running. Baremetal checks a
+/// single version number every cycle, and only reads the parameters that
+/// changed. Related parameters are updated together as a batch.
+struct ParameterStruct {
+    ParameterStore<64> parameters;
+
+  private:
+    friend volatile ParameterStruct *initAt<ParameterStruct>(volatile void *);
+    ParameterStruct() = default;
+};
+
+// ================================== RPC =================================== //
+
+/// Remote procedure calls from Linux to Baremetal, see RpcClient.hpp.
+struct RpcStruct {
+    RpcChannel<16> channel;
+
+  private:
+    friend volatile RpcStruct *initAt<RpcStruct>(volatile void *);
+    RpcStruct() = default;
+};
+
+/// Returns the sum of two numbers.
+struct RpcAdd {
+    constexpr static uint16_t ID = 1;
+    struct Request {
+        uint32_t a, b;
+    };
+    using Response = uint32_t;
+};
+
+/// Returns the shared counter of TestStruct.
+struct RpcGetCounter {
+    constexpr static uint16_t ID = 2;
+    struct Request {};
+    using Response = uint32_t;
+};
+
+/// Makes Baremetal leave its dispatch loop after responding.
+struct RpcStop {
+    constexpr static uint16_t ID = 3;
+    struct Request {};
+    struct Response {};
+};
+
+// ================================= TRACE ================================== //
+
+/// Events traced by sharedmem.cpp and ipc_bench.cpp.
+enum TraceEvent : uint16_t {
+    TRACE_ACK = TRACE_SYNC + 1,  ///< arg0 = new value of `ack`
+    TRACE_INCREMENT_DONE,        ///< arg0 = number of increments
+    TRACE_MESSAGE_SENT,          ///< arg0 = id
+    TRACE_MESSAGE_RECEIVED,      ///< arg0 = id
+    TRACE_MESSAGE_ECHOED,        ///< arg0 = id
+    TRACE_STOP,
+    TRACE_RPC_DONE,  ///< arg0 = number of calls served
+};
+
+inline const char *traceEventName(uint16_t event) {
+    switch (event) {
+        case TRACE_SYNC: return "sync";
+        case TRACE_ACK: return "ack";
+        case TRACE_INCREMENT_DONE: return "increment done";
+        case TRACE_MESSAGE_SENT: return "message sent";
+        case TRACE_MESSAGE_RECEIVED: return "message received";
+        case TRACE_MESSAGE_ECHOED: return "message echoed";
+        case TRACE_STOP: return "stop";
+        case TRACE_RPC_DONE: return "rpc done";
+        default: return "unknown";
+    }
+}
+
+/// Binary event traces, one ring per core, decoded on Linux by trace_dump.cpp.
+/// Much cheaper than printing, so tracing doesn't hide timing issues.
+struct TraceStruct {
+    TraceRing<256> rings[NUM_CORES];
+
+    /// Record an event in the ring of the given core.
+    void trace(uint16_t event, uint32_t arg0 = 0, uint32_t arg1 = 0,
+               Core core = THIS_CORE) volatile {
+        rings[core].record(event, arg0, arg1, core);
+    }
+    /// Same, with a timestamp the caller already read.
+    void traceAt(uint64_t timestamp, uint16_t event, uint32_t arg0 = 0,
+                 uint32_t arg1 = 0, Core core = THIS_CORE) volatile {
+        rings[core].recordAt(timestamp, event, arg0, arg1, core);
+    }
+
+  private:
+    friend volatile TraceStruct *initAt<TraceStruct>(volatile void *);
+    TraceStruct() = default;
+};
+
+// ================================= LAYOUT ================================= //
+
+/// Addresses of all shared structs. The first 8 KiB of the window are left
+/// unused.
+using SharedLayout =
+    SharedMemLayout<SHARED_MEM_START_ADDRESS + 0x2000, TestStruct,
+                    MessageChannel, TelemetryStruct, LatencyStruct,
+                    FrameExchange, TraceStruct, RpcStruct,
+                    ControlStruct, SettingsStruct, ParameterStruct,
+                    CounterStruct>;
+
+template <class T>
+struct SharedMemAddress<T,
+                        std::enable_if_t<SharedLayout::contains<T>>> {
+    constexpr static uintptr_t value = SharedLayout::addressOf<T>();
+};
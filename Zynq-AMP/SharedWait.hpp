@@ -0,0 +1,209 @@
+#pragma once
+
+#include <CpuUtils.hpp>  // cpuRelax, monotonicMicros
+
+#include <algorithm>  // min
+#include <atomic>     // atomic, atomic_thread_fence
+#include <cstdint>    // uint32_t, uint64_t
+#ifdef BAREMETAL
+#include <ps7_cortexa9_1/include/sleep.h>
+#include <xscugic.h>
+#else
+#include <cerrno>         // errno
+#include <fcntl.h>        // open
+#include <poll.h>         // ppoll
+#include <stdexcept>      // runtime_error
+#include <string>         // string
+#include <sys/eventfd.h>  // eventfd
+#include <unistd.h>       // read, write, close, usleep
+#endif
+
+// =============================== DOORBELLS ================================ //
+
+// A doorbell wakes up a waiter on the other side. All doorbells remember a
+// ring that happened before the waiter started waiting, so waking up can never
+// be missed. Waiting may return early, the waiter always checks its condition
+// again.
+//
+// `bool wait(uint32_t timeoutUs)` blocks until the doorbell rang or until the
+// timeout expired, `void ring()` wakes up the waiter.
+
+/// Wait for an event (`wfe`), ring by sending an event to all cores (`sev`).
+/// Works in both directions on the Zynq. The timeout is not exact, since only
+/// events and interrupts wake up the core. On other architectures, waiting
+/// just polls.
+struct SevDoorbell {
+    bool wait(uint32_t) {
+#if defined(__arm__)
+        __asm__ __volatile__("wfe" ::: "memory");
+#else
+        cpuRelax();
+#endif
+        return true;
+    }
+    void ring() {
+#if defined(__arm__)
+        __asm__ __volatile__("dsb\n\tsev" ::: "memory");
+#endif
+    }
+};
+
+#ifdef BAREMETAL
+/// Ring the Linux core by raising a software-generated interrupt, which Linux
+/// receives through a UioDoorbell.
+class GicDoorbell {
+  public:
+    GicDoorbell(XScuGic &gic, uint32_t interruptId, uint32_t cpuMask = 0b01)
+        : gic{gic}, interruptId{interruptId}, cpuMask{cpuMask} {}
+    void ring() { XScuGic_SoftwareIntr(&gic, interruptId, cpuMask); }
+
+  private:
+    XScuGic &gic;
+    uint32_t interruptId;
+    uint32_t cpuMask;
+};
+
+#else
+/// Block on a file descriptor until it becomes readable.
+inline bool pollReadable(int fd, uint32_t timeoutUs) {
+    pollfd pfd = {fd, POLLIN, 0};
+    timespec timeout;
+    timeout.tv_sec  = timeoutUs / 1'000'000;
+    timeout.tv_nsec = (timeoutUs % 1'000'000) * 1'000;
+    int r           = ppoll(&pfd, 1, &timeout, nullptr);
+    return r > 0 || (r < 0 && errno == EINTR);
+}
+
+/// Software stand-in for the interrupt between the cores, for testing on a
+/// host. The eventfd is inherited by child processes.
+class EventfdDoorbell {
+  public:
+    EventfdDoorbell() : fd{eventfd(0, 0)} {
+        if (fd < 0)
+            throw std::runtime_error("eventfd failed (" +
+                                     std::to_string(errno) + ")");
+    }
+    ~EventfdDoorbell() { close(fd); }
+    EventfdDoorbell(const EventfdDoorbell &) = delete;
+    EventfdDoorbell &operator=(const EventfdDoorbell &) = delete;
+
+    bool wait(uint32_t timeoutUs) {
+        if (!pollReadable(fd, timeoutUs))
+            return false;
+        uint64_t count;
+        return read(fd, &count, sizeof(count)) == sizeof(count);
+    }
+    void ring() {
+        uint64_t one = 1;
+        (void) write(fd, &one, sizeof(one));
+    }
+
+  private:
+    int fd;
+};
+
+/// Wait for an interrupt from the bare-metal core, using a UIO device
+/// (e.g. `/dev/uio0`).
+class UioDoorbell {
+  public:
+    UioDoorbell(const char *device) : fd{open(device, O_RDWR)} {
+        if (fd < 0)
+            throw std::runtime_error("open(" + std::string(device) +
+                                     ") failed (" + std::to_string(errno) +
+                                     ")");
+    }
+    ~UioDoorbell() { close(fd); }
+    UioDoorbell(const UioDoorbell &) = delete;
+    UioDoorbell &operator=(const UioDoorbell &) = delete;
+
+    bool wait(uint32_t timeoutUs) {
+        uint32_t enable = 1;  // Re-enable the interrupt
+        (void) write(fd, &enable, sizeof(enable));
+        if (!pollReadable(fd, timeoutUs))
+            return false;
+        uint32_t count;
+        return read(fd, &count, sizeof(count)) == sizeof(count);
+    }
+
+  private:
+    int fd;
+};
+#endif
+
+/// Fallback when no interrupt is available: sleep for a fixed period.
+struct SleepDoorbell {
+    uint32_t periodUs = 50;
+    bool wait(uint32_t timeoutUs) {
+        usleep(std::min(timeoutUs, periodUs));
+        return true;
+    }
+    void ring() {}
+};
+
+// ================================== WAIT ================================== //
+
+/// Number of waiters that are blocked on a doorbell. Lives in the shared
+/// memory, so the notifier only rings the doorbell if someone is sleeping.
+struct WaitQueue {
+    std::atomic<uint32_t> sleepers = {0};
+};
+
+/// How to wait for a condition in shared memory.
+struct WaitConfig {
+    /// Spin for this long before blocking on the doorbell (µs).
+    uint32_t spinUs = 20;
+    /// Give up after this time (µs).
+    uint32_t timeoutUs = UINT32_MAX;
+};
+
+/**
+ * @brief   Wait until the condition is true. Spins first, so hot traffic is
+ *          picked up without any system call, and then blocks on the doorbell
+ *          so an idle waiter doesn't burn a core.
+ *
+ * @param   queue
+ *          Shared wait queue that the notifier passes to notify().
+ * @param   doorbell
+ *          Doorbell that is rung by the notifier.
+ * @param   condition
+ *          Function that checks the shared memory.
+ * @return  False if the timeout expired, true otherwise.
+ */
+template <class Doorbell, class Condition>
+bool waitUntil(volatile WaitQueue &queue, Doorbell &doorbell,
+               Condition condition, const WaitConfig &config = {}) {
+    if (condition())
+        return true;
+    uint64_t start = monotonicMicros(), elapsed = 0;
+    // Spin
+    while ((elapsed = monotonicMicros() - start) < config.spinUs) {
+        for (unsigned i = 0; i < 64; ++i) {
+            if (condition())
+                return true;
+            cpuRelax();
+        }
+    }
+    // Block
+    while (elapsed < config.timeoutUs) {
+        queue.sleepers.fetch_add(1, std::memory_order_seq_cst);
+        // Check again: the notifier may have missed the increment above
+        bool done = condition();
+        if (!done)
+            doorbell.wait(std::min<uint64_t>(config.timeoutUs - elapsed,
+                                             UINT32_MAX));
+        queue.sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if (done || condition())
+            return true;
+        elapsed = monotonicMicros() - start;
+    }
+    return false;
+}
+
+/// Wake up the other side after changing the shared memory. Only rings the
+/// doorbell if someone is sleeping.
+template <class Doorbell>
+void notify(volatile WaitQueue &queue, Doorbell &doorbell) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (queue.sleepers.load(std::memory_order_relaxed) > 0)
+        doorbell.ring();
+}
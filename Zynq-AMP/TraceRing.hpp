@@ -0,0 +1,161 @@
+#pragma once
+
+#include <CpuUtils.hpp>         // timestampTicks, TICKS_PER_SECOND
+#include <SharedMemConfig.hpp>  // CACHE_LINE_SIZE, Core, THIS_CORE
+
+#include <atomic>   // atomic, atomic_thread_fence
+#include <cstddef>  // size_t
+#include <cstdint>  // uint16_t, uint32_t, uint64_t
+
+/// Event recorded by both cores at the same moment (e.g. a handshake), with
+/// the same `arg0`, so their clocks can be aligned when decoding.
+constexpr uint16_t TRACE_SYNC = 0;
+
+/// Decoded trace event.
+struct TraceRecord {
+    uint64_t timestamp;  ///< In ticks of the core that recorded it
+    uint32_t sequence;   ///< Index of the event in its ring
+    uint16_t core;
+    uint16_t event;
+    uint32_t arg0;
+    uint32_t arg1;
+};
+
+/**
+ * @brief   Wrap-around ring of binary trace events, that can live in the
+ *          shared memory.
+ *
+ * Recording an event never blocks and never waits for a reader: it claims a
+ * slot with a single atomic increment, and overwrites the oldest event when
+ * the ring is full. Each slot has a sequence number that is odd while it's
+ * being written, so a reader can detect (and drop) events that were
+ * overwritten while it was copying them. Readers never write to the ring.
+ *
+ * Use one ring per core, so each core only writes to its own cache lines.
+ *
+ * Most of the cost of record() is reading the clock, especially on Linux.
+ * Loops that already read the clock can pass their timestamp to recordAt().
+ *
+ * @tparam  N
+ *          The number of events in the ring, a power of two.
+ */
+template <size_t N>
+class TraceRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                  "The ring must be lock-free");
+
+  public:
+    constexpr static size_t CAPACITY = N;
+
+    TraceRing() = default;
+    TraceRing(const TraceRing &) = delete;
+    TraceRing &operator=(const TraceRing &) = delete;
+
+    /// Record an event. Safe to call from multiple threads of the same core.
+    void record(uint16_t event, uint32_t arg0 = 0, uint32_t arg1 = 0,
+                Core core = THIS_CORE) {
+        recordAt(timestampTicks(), event, arg0, arg1, core);
+    }
+
+    /// Record an event with a timestamp (from timestampTicks) that the caller
+    /// already read, without reading the clock again.
+    void recordAt(uint64_t timestamp, uint16_t event, uint32_t arg0 = 0,
+                  uint32_t arg1 = 0, Core core = THIS_CORE) {
+        uint32_t i = head.fetch_add(1, std::memory_order_relaxed);
+        Slot &slot = slots[i % N];
+        slot.seq.store(2 * i + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.words[0].store(uint32_t(timestamp), std::memory_order_relaxed);
+        slot.words[1].store(uint32_t(timestamp >> 32),
+                            std::memory_order_relaxed);
+        slot.words[2].store(uint32_t(core) << 16 | event,
+                            std::memory_order_relaxed);
+        slot.words[3].store(arg0, std::memory_order_relaxed);
+        slot.words[4].store(arg1, std::memory_order_relaxed);
+        slot.seq.store(2 * i + 2, std::memory_order_release);
+    }
+
+    /// Set the unit of the timestamps. Writer only, before recording.
+    void setTicksPerSecond(uint32_t ticksPerSecond) {
+        this->ticksPerSecond.store(ticksPerSecond, std::memory_order_relaxed);
+    }
+    uint32_t getTicksPerSecond() const {
+        return ticksPerSecond.load(std::memory_order_relaxed);
+    }
+
+    /// Total number of events recorded, including the overwritten ones.
+    uint32_t recorded() const { return head.load(std::memory_order_acquire); }
+
+    /**
+     * @brief   Copy the events that are still in the ring, oldest first.
+     *
+     * @param   out
+     *          Buffer with room for at least N events.
+     * @param   from
+     *          Skip the events before this index, e.g. the value of
+     *          recorded() after the previous call.
+     * @return  The number of events copied. Events that were being written
+     *          or overwritten while copying are left out.
+     */
+    size_t read(TraceRecord *out, uint32_t from = 0) const {
+        uint32_t end   = head.load(std::memory_order_acquire);
+        uint32_t begin = end - from > N ? end - N : from;
+        size_t count   = 0;
+        for (uint32_t i = begin; i != end; ++i) {
+            const Slot &slot = slots[i % N];
+            uint32_t s       = slot.seq.load(std::memory_order_acquire);
+            if (s != 2 * i + 2)
+                continue;
+            uint32_t w[NUM_WORDS];
+            for (size_t j = 0; j < NUM_WORDS; ++j)
+                w[j] = slot.words[j].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != s)
+                continue;
+            out[count++] = {uint64_t(w[1]) << 32 | w[0],
+                            i,
+                            uint16_t(w[2] >> 16),
+                            uint16_t(w[2]),
+                            w[3],
+                            w[4]};
+        }
+        return count;
+    }
+
+    void record(uint16_t event, uint32_t arg0 = 0, uint32_t arg1 = 0,
+                Core core = THIS_CORE) volatile {
+        self()->record(event, arg0, arg1, core);
+    }
+    void recordAt(uint64_t timestamp, uint16_t event, uint32_t arg0 = 0,
+                  uint32_t arg1 = 0, Core core = THIS_CORE) volatile {
+        self()->recordAt(timestamp, event, arg0, arg1, core);
+    }
+    void setTicksPerSecond(uint32_t ticksPerSecond) volatile {
+        self()->setTicksPerSecond(ticksPerSecond);
+    }
+    uint32_t getTicksPerSecond() const volatile {
+        return self()->getTicksPerSecond();
+    }
+    uint32_t recorded() const volatile { return self()->recorded(); }
+    size_t read(TraceRecord *out, uint32_t from = 0) const volatile {
+        return self()->read(out, from);
+    }
+
+  private:
+    TraceRing *self() volatile { return const_cast<TraceRing *>(this); }
+    const TraceRing *self() const volatile {
+        return const_cast<const TraceRing *>(this);
+    }
+
+    constexpr static size_t NUM_WORDS = 5;
+
+    struct Slot {
+        std::atomic<uint32_t> seq = {0};
+        std::atomic<uint32_t> words[NUM_WORDS];
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> head = {0};
+    std::atomic<uint32_t> ticksPerSecond = {TICKS_PER_SECOND};
+    alignas(CACHE_LINE_SIZE) Slot slots[N];
+};
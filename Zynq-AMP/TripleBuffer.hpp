@@ -0,0 +1,110 @@
+#pragma once
+
+#include <SharedMemConfig.hpp>  // CACHE_LINE_SIZE
+
+#include <atomic>       // atomic
+#include <cstdint>      // uint32_t
+#include <type_traits>  // is_trivially_copyable
+
+/**
+ * @brief   Passes the latest value of a (large) struct from one writer to one
+ *          reader, using three buffers in the shared memory.
+ *
+ * The writer always owns one buffer and the reader another, the third one
+ * holds the latest complete frame. Publishing or picking up a frame only
+ * swaps the index of a buffer with the middle one, using a single atomic
+ * exchange, so frames of any size move without locks or copies, and neither
+ * side ever waits for the other. The reader never sees a torn frame: the
+ * writer can't touch a buffer the reader owns. Frames that are overwritten
+ * before the reader picks them up are skipped, the sequence number tells how
+ * many.
+ *
+ * @tparam  T
+ *          The type of the frames. Must be trivially copyable.
+ */
+template <class T>
+class TripleBuffer {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+                  "The buffer index must be lock-free");
+
+  public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    /// Buffer the writer can fill in place. Writer only.
+    T &back() { return buffers[backIndex].data; }
+
+    /// Make the back buffer the latest frame, and get a new back buffer.
+    /// Writer only.
+    void publish() {
+        buffers[backIndex].sequence = ++written;
+        uint32_t previous =
+            middle.exchange(backIndex | NEW, std::memory_order_acq_rel);
+        backIndex = previous & INDEX;
+    }
+
+    /// Copy a frame into the back buffer and publish it. Writer only.
+    void write(const T &t) {
+        back() = t;
+        publish();
+    }
+
+    /// Pick up the latest frame, if there is one the reader hasn't seen yet.
+    /// Reader only. Returns false if front() didn't change.
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & NEW) == 0)
+            return false;
+        uint32_t previous =
+            middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & INDEX;
+        return true;
+    }
+
+    /// Latest frame picked up by update(). Reader only.
+    const T &front() const { return buffers[frontIndex].data; }
+    /// Number of frames published before front(), starting from 1 (0 if
+    /// there's no frame yet). Reader only.
+    uint32_t sequence() const { return buffers[frontIndex].sequence; }
+
+    /// Copy the latest frame, if it's newer than the previous one. Reader only.
+    bool read(T &t) {
+        if (!update())
+            return false;
+        t = front();
+        return true;
+    }
+
+    T &back() volatile { return self()->back(); }
+    void publish() volatile { self()->publish(); }
+    void write(const T &t) volatile { self()->write(t); }
+    bool update() volatile { return self()->update(); }
+    const T &front() const volatile { return self()->front(); }
+    uint32_t sequence() const volatile { return self()->sequence(); }
+    bool read(T &t) volatile { return self()->read(t); }
+
+  private:
+    // Buffers are only accessed by their owner, so they don't have to be
+    // volatile.
+    TripleBuffer *self() volatile { return const_cast<TripleBuffer *>(this); }
+    const TripleBuffer *self() const volatile {
+        return const_cast<const TripleBuffer *>(this);
+    }
+
+    constexpr static uint32_t INDEX = 0x3;
+    constexpr static uint32_t NEW   = 0x4;  ///< Middle buffer not read yet
+
+    struct alignas(CACHE_LINE_SIZE) Buffer {
+        uint32_t sequence = 0;
+        T data;
+    };
+
+    // Each index lives on the cache line of the only core that writes it
+    alignas(CACHE_LINE_SIZE) uint32_t backIndex = 0;
+    uint32_t written                            = 0;
+    alignas(CACHE_LINE_SIZE) uint32_t frontIndex = 1;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> middle = {2};
+    Buffer buffers[3];
+};
@@ -0,0 +1,105 @@
+// Host-side stand-in for eagle_setup_ipc.cpp: instead of touching the MMU and
+// the caches, it counts the maintenance operations, so different policies can
+// be compared off-target.
+
+#include "eagle_setup_ipc.hpp"
+
+constexpr uint32_t SECTION_SIZE   = 0x100000;
+constexpr uint32_t L1_LINE_LENGTH = 32;
+constexpr uint32_t L1_NUM_LINES   = 32 * 1024 / L1_LINE_LENGTH;
+constexpr uint32_t OCM_HIGH_START = 0xFFFC0000;
+
+static EagleCacheStats stats = {};
+
+EagleCacheStats eagle_GetCacheStats(void) { return stats; }
+void eagle_ResetCacheStats(void) { stats = {}; }
+
+void eagle_setup_ipc(void) {
+    eagle_SetTlbAttributes(0xFFFF0000, EAGLE_NONCACHEABLE);
+}
+
+void eagle_setup_ipc(const EagleRegion *regions, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        eagle_SetRegionAttributes(regions[i].address, regions[i].size,
+                                  regions[i].attrib);
+}
+
+void eagle_DCacheFlush(void) {
+    ++stats.fullFlushes;
+    stats.lineFlushes += L1_NUM_LINES;
+    ++stats.barriers;
+}
+
+void eagle_SetTlbAttributes(uint32_t addr, uint32_t attrib) {
+    eagle_SetRegionAttributes(addr, 1, attrib);
+}
+
+void eagle_SetRegionAttributes(uint32_t addr, uint32_t size, uint32_t) {
+    eagle_DCacheFlush();
+    uint32_t first = addr / SECTION_SIZE;
+    uint32_t last  = (addr + (size ? size - 1 : 0)) / SECTION_SIZE;
+    stats.attributeChanges += last - first + 1;
+    // Clean the entries (the table is in DDR, behind the L2 cache), then
+    // invalidate the TLB
+    constexpr uint32_t ENTRIES_PER_LINE = L1_LINE_LENGTH / 4;
+    uint32_t lines = last / ENTRIES_PER_LINE - first / ENTRIES_PER_LINE + 1;
+    stats.lineCleans += lines;
+    stats.l2Lines += lines;
+    stats.barriers += 3;
+}
+
+static void maintainLines(uintptr_t addr, size_t size,
+                          EagleCacheOpType type) {
+    if (size == 0)
+        return;
+    uintptr_t last      = addr + (size - 1);
+    uintptr_t firstLine = addr & ~uintptr_t(L1_LINE_LENGTH - 1);
+    uintptr_t lastLine  = last & ~uintptr_t(L1_LINE_LENGTH - 1);
+    for (uintptr_t line = firstLine;; line += L1_LINE_LENGTH) {
+        bool partial = line < addr || line + (L1_LINE_LENGTH - 1) > last;
+        switch (type) {
+            case EAGLE_CLEAN:
+                ++stats.lineCleans;
+                break;
+            case EAGLE_INVALIDATE:
+                // Partial lines are flushed, like on the target
+                if (!partial) {
+                    ++stats.lineInvalidates;
+                    break;
+                }
+                [[fallthrough]];
+            case EAGLE_FLUSH:
+                ++stats.lineFlushes;
+                break;
+        }
+        if (line == lastLine)
+            break;
+    }
+    // Everything except the OCM goes through the L2 cache, which has lines of
+    // the same size, and ends with a sync
+    if (addr < OCM_HIGH_START) {
+        stats.l2Lines += (lastLine - firstLine) / L1_LINE_LENGTH + 1;
+        ++stats.barriers;
+    }
+}
+
+void eagle_DCacheCleanRange(uintptr_t addr, size_t size) {
+    maintainLines(addr, size, EAGLE_CLEAN);
+    ++stats.barriers;
+}
+
+void eagle_DCacheInvalidateRange(uintptr_t addr, size_t size) {
+    maintainLines(addr, size, EAGLE_INVALIDATE);
+    ++stats.barriers;
+}
+
+void eagle_DCacheFlushRange(uintptr_t addr, size_t size) {
+    maintainLines(addr, size, EAGLE_FLUSH);
+    ++stats.barriers;
+}
+
+void eagle_DCacheMaintain(const EagleCacheOp *ops, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        maintainLines(ops[i].address, ops[i].size, ops[i].type);
+    ++stats.barriers;
+}
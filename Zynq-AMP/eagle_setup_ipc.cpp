@@ -2,15 +2,32 @@
 
 #include "xil_cache.h"
 #include "xil_mmu.h"
+#include "xpseudo_asm.h"
+#include "xreg_cortexa9.h"
 #include "xscugic.h"
 
 // https://www.xilinx.com/support/documentation/application_notes/xapp1078-amp-linux-bare-metal.pdf
 
 extern "C" void Xil_L1DCacheFlush(void);
+extern "C" void Xil_L2CacheStoreRange(INTPTR adr, u32 len);
+extern "C" void Xil_L2CacheInvalidateRange(INTPTR adr, u32 len);
+extern "C" void Xil_L2CacheFlushRange(INTPTR adr, u32 len);
 
 extern u32 MMUTable;
 
-void eagle_setup_ipc(void) { eagle_SetTlbAttributes(0xFFFF0000, 0x04de2); }
+constexpr u32 SECTION_SIZE   = 0x100000;
+constexpr u32 L1_LINE_LENGTH = 32;
+constexpr u32 OCM_HIGH_START = 0xFFFC0000;
+
+void eagle_setup_ipc(void) {
+    eagle_SetTlbAttributes(0xFFFF0000, EAGLE_NONCACHEABLE);
+}
+
+void eagle_setup_ipc(const EagleRegion *regions, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        eagle_SetRegionAttributes(regions[i].address, regions[i].size,
+                                  regions[i].attrib);
+}
 
 void eagle_DCacheFlush(void) {
     Xil_L1DCacheFlush();
@@ -18,18 +35,104 @@ void eagle_DCacheFlush(void) {
 }
 
 void eagle_SetTlbAttributes(u32 addr, u32 attrib) {
-    u32 *ptr;
-    u32 section;
+    eagle_SetRegionAttributes(addr, 1, attrib);
+}
 
-    mtcp(XREG_CP15_INVAL_UTLB_UNLOCKED, 0);
-    dsb();
+// Same order as Xil_SetTlbAttributes: the TLB and branch predictor are
+// invalidated after the new entries reach memory, otherwise stale TLB entries
+// could keep the old attributes.
+void eagle_SetRegionAttributes(u32 addr, u32 size, u32 attrib) {
+    // Lines of the region may still be in the cache
+    eagle_DCacheFlush();
+
+    u32 first = addr / SECTION_SIZE;
+    u32 last  = (addr + (size ? size - 1 : 0)) / SECTION_SIZE;
+    for (u32 section = first; section <= last; ++section)
+        (&MMUTable)[section] = (section * SECTION_SIZE) | attrib;
+    // The table walk reads from memory, ends with a barrier
+    eagle_DCacheCleanRange(uintptr_t(&(&MMUTable)[first]),
+                           (last - first + 1) * sizeof(u32));
 
+    mtcp(XREG_CP15_INVAL_UTLB_UNLOCKED, 0);
     mtcp(XREG_CP15_INVAL_BRANCH_ARRAY, 0);
     dsb();
-    eagle_DCacheFlush();
+    isb();
+}
+
+// =========================== RANGED MAINTENANCE =========================== //
 
-    section = addr / 0x100000;
-    ptr     = &MMUTable + section;
-    *ptr    = (addr & 0xFFF00000) | attrib;
+// Everything except the OCM goes through the PL310 L2 cache as well. Cleaning
+// has to write the L1 lines back before the L2 lines, invalidating has to
+// discard the L2 lines first, so L1 cannot be refilled with stale data.
+
+static bool behindL2(uintptr_t addr) { return addr < OCM_HIGH_START; }
+
+static void maintainLines(uintptr_t addr, size_t size,
+                          EagleCacheOpType type) {
+    if (size == 0)
+        return;
+    // Last byte instead of one past the end, which overflows for ranges at
+    // the top of the address space (the OCM)
+    uintptr_t last      = addr + (size - 1);
+    uintptr_t firstLine = addr & ~uintptr_t(L1_LINE_LENGTH - 1);
+    uintptr_t lastLine  = last & ~uintptr_t(L1_LINE_LENGTH - 1);
+    for (uintptr_t line = firstLine;; line += L1_LINE_LENGTH) {
+        bool partial = line < addr || line + (L1_LINE_LENGTH - 1) > last;
+        switch (type) {
+            case EAGLE_CLEAN:
+                mtcp(XREG_CP15_CLEAN_DC_LINE_MVA_POC, line);
+                break;
+            case EAGLE_INVALIDATE:
+                // Don't throw away data next to the range in partial lines
+                if (!partial) {
+                    mtcp(XREG_CP15_INVAL_DC_LINE_MVA_POC, line);
+                    break;
+                }
+                [[fallthrough]];
+            case EAGLE_FLUSH:
+                mtcp(XREG_CP15_CLEAN_INVAL_DC_LINE_MVA_POC, line);
+                break;
+        }
+        if (line == lastLine)
+            break;
+    }
+}
+
+// The Xilinx L2 range functions handle partial lines the same way, and end
+// with their own cache sync.
+static void maintainL2(uintptr_t addr, size_t size, EagleCacheOpType type) {
+    if (size == 0 || !behindL2(addr))
+        return;
+    switch (type) {
+        case EAGLE_CLEAN: Xil_L2CacheStoreRange(addr, size); break;
+        case EAGLE_INVALIDATE: Xil_L2CacheInvalidateRange(addr, size); break;
+        case EAGLE_FLUSH: Xil_L2CacheFlushRange(addr, size); break;
+    }
+}
+
+void eagle_DCacheCleanRange(uintptr_t addr, size_t size) {
+    EagleCacheOp op = {addr, size, EAGLE_CLEAN};
+    eagle_DCacheMaintain(&op, 1);
+}
+
+void eagle_DCacheInvalidateRange(uintptr_t addr, size_t size) {
+    EagleCacheOp op = {addr, size, EAGLE_INVALIDATE};
+    eagle_DCacheMaintain(&op, 1);
+}
+
+void eagle_DCacheFlushRange(uintptr_t addr, size_t size) {
+    EagleCacheOp op = {addr, size, EAGLE_FLUSH};
+    eagle_DCacheMaintain(&op, 1);
+}
+
+void eagle_DCacheMaintain(const EagleCacheOp *ops, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        if (ops[i].type == EAGLE_INVALIDATE)
+            maintainL2(ops[i].address, ops[i].size, ops[i].type);
+    for (size_t i = 0; i < count; ++i)
+        maintainLines(ops[i].address, ops[i].size, ops[i].type);
     dsb();
-}
\ No newline at end of file
+    for (size_t i = 0; i < count; ++i)
+        if (ops[i].type != EAGLE_INVALIDATE)
+            maintainL2(ops[i].address, ops[i].size, ops[i].type);
+}
@@ -1,7 +1,69 @@
 #pragma once
 
-#include <cstdint>  // uint32_t
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uintptr_t
+
+// Memory attributes for a 1 MiB section in the translation table.
+enum EagleMemAttrib : uint32_t {
+    /// Strongly-ordered: every access goes to memory, in program order.
+    EAGLE_STRONGLY_ORDERED = 0x00C02,
+    /// Shareable device memory.
+    EAGLE_DEVICE = 0x00C06,
+    /// Normal, non-cacheable memory (XAPP1078, used for the OCM by default).
+    EAGLE_NONCACHEABLE = 0x04DE2,
+    /// Normal, shareable, write-back cacheable memory. Requires explicit cache
+    /// maintenance when shared with the other core.
+    EAGLE_WRITE_BACK = 0x15DE6,
+};
+
+/// Shared memory region with its own attributes. Address and size are
+/// rounded to 1 MiB sections.
+struct EagleRegion {
+    uint32_t address;
+    uint32_t size;
+    uint32_t attrib;
+};
+
+enum EagleCacheOpType {
+    EAGLE_CLEAN,       ///< Write dirty lines back to memory (producer)
+    EAGLE_INVALIDATE,  ///< Discard lines, so the next read fetches from memory
+    EAGLE_FLUSH,       ///< Clean and invalidate
+};
+
+/// Cache maintenance operation on an address range.
+struct EagleCacheOp {
+    uintptr_t address;
+    size_t size;
+    EagleCacheOpType type;
+};
 
 void eagle_setup_ipc(void);
+void eagle_setup_ipc(const EagleRegion *regions, size_t count);
 void eagle_DCacheFlush(void);
-void eagle_SetTlbAttributes(uint32_t addr, uint32_t attrib);
\ No newline at end of file
+void eagle_SetTlbAttributes(uint32_t addr, uint32_t attrib);
+void eagle_SetRegionAttributes(uint32_t addr, uint32_t size, uint32_t attrib);
+
+// Maintenance of the data cache lines that overlap with the given range,
+// instead of the entire cache. Ranges outside the OCM are maintained in the
+// L2 cache as well. Each call has a single barrier for the L1 cache.
+void eagle_DCacheCleanRange(uintptr_t addr, size_t size);
+void eagle_DCacheInvalidateRange(uintptr_t addr, size_t size);
+void eagle_DCacheFlushRange(uintptr_t addr, size_t size);
+// Several ranges at once, with a single L1 barrier.
+void eagle_DCacheMaintain(const EagleCacheOp *ops, size_t count);
+
+#ifndef BAREMETAL
+// Off-target, eagle_cache_sim.cpp implements the functions above by counting
+// the maintenance operations, to compare policies on a host.
+struct EagleCacheStats {
+    uint32_t lineCleans;        ///< Lines cleaned
+    uint32_t lineInvalidates;   ///< Lines invalidated
+    uint32_t lineFlushes;       ///< Lines cleaned and invalidated
+    uint32_t l2Lines;           ///< L2 lines maintained (outside the OCM)
+    uint32_t fullFlushes;       ///< Calls to eagle_DCacheFlush
+    uint32_t barriers;          ///< Data synchronization barriers
+    uint32_t attributeChanges;  ///< Translation table entries written
+};
+EagleCacheStats eagle_GetCacheStats(void);
+void eagle_ResetCacheStats(void);
+#endif
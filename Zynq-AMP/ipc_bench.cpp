@@ -0,0 +1,815 @@
+// Host benchmark for the shared-memory IPC of sharedmem.cpp. A child process
+// stands in for the bare-metal core, so this can run on any Linux machine.
+// Link it with eagle_cache_sim.cpp, which counts the cache maintenance that
+// Baremetal would do.
+//
+// Usage: ipc_bench [memfd | shm <name> | file <path> | devmem]
+
+#include <MessageMultiplexer.hpp>  // MessageMultiplexer
+#include <PollReactor.hpp>         // PollReactor
+#include <SharedMem.hpp>           // BaremetalShared, SharedMemReferenceCounter
+#include <SharedStructs.hpp>       // TestStruct, MessageChannel, TraceStruct,
+                                   // RpcStruct, ParameterStruct, CounterStruct
+#if __cpp_impl_coroutine
+#include <RpcClient.hpp>  // RpcClient, RpcTask
+#endif
+#include "eagle_setup_ipc.hpp"  // eagle_DCache*, eagle_GetCacheStats
+
+#include <algorithm>  // sort
+#include <array>      // array
+#include <atomic>     // atomic
+#include <chrono>     // steady_clock
+#include <cstdint>    // uint32_t
+#include <future>     // future_status
+#include <iomanip>    // setw
+#include <iostream>   // cout
+#include <stdexcept>  // runtime_error
+#include <string>     // string
+#include <thread>     // thread
+#include <vector>     // vector
+
+#include <sched.h>     // sched_yield
+#include <sys/mman.h>  // shm_unlink
+#include <sys/wait.h>  // waitpid
+#include <unistd.h>    // fork
+
+using clk = std::chrono::steady_clock;
+
+/// Values of TestStruct::ack used by the benchmark.
+enum Ack : uint32_t {
+    Request = 1,  ///< Linux has written testLinux2Baremetal
+    Reply   = 2,  ///< Baremetal has written testBaremetal2Linux
+    Done    = 3,  ///< Baremetal has finished incrementing
+    Go      = 4,  ///< Linux has finished the handshake benchmark
+    Stop    = 5,  ///< Linux has finished the telemetry benchmark
+};
+
+/// Spin for a while, then give up the CPU, so the benchmark doesn't stall when
+/// both processes have to share a single core.
+template <class Condition>
+void spinUntil(Condition condition) {
+    for (unsigned i = 0; !condition(); ++i)
+        if (i >= 1'000)
+            sched_yield();
+}
+
+/// Wait until both cores arrived at the given barrier (numbered from 0).
+void barrier(volatile CounterStruct *cnt, uint32_t index) {
+    cnt->arrived.fetch_add(1, std::memory_order_acq_rel);
+    spinUntil([&] {
+        return cnt->arrived.load(std::memory_order_acquire) >= 2 * (index + 1);
+    });
+}
+
+/// Increment each of the counters of CounterStruct, at the same time as the
+/// other core. Returns the time per increment (ns) of the locked, atomic and
+/// sharded counters.
+std::array<double, 3> countAll(volatile CounterStruct *cnt, Core core,
+                               uint32_t count) {
+    // The other process may not get the CPU for a while, don't give up
+    LockConfig config;
+    config.timeoutUs = 1'000'000;
+    auto round       = [&](uint32_t index, auto add) {
+        barrier(cnt, index);
+        auto start = clk::now();
+        for (uint32_t i = 0; i < count; ++i)
+            add();
+        std::chrono::duration<double, std::nano> duration = clk::now() - start;
+        return duration.count() / count;
+    };
+    std::array<double, 3> ns = {
+        round(0, [&] { cnt->addLocked(config); }),
+        round(1, [&] { cnt->atomic.add(); }),
+        round(2, [&] { cnt->sharded.add(1, core); }),
+    };
+    barrier(cnt, 3);  // Both are done
+    return ns;
+}
+
+// ============================== BARE-METAL ================================ //
+
+/// Echo all messages until STOP is received. Parks on the doorbell while
+/// Linux isn't sending anything.
+void echo(volatile MessageChannel *ch, EventfdDoorbell &doorbell) {
+    Message msgs[32];
+    while (true) {
+        size_t n = 0;
+        while (!waitUntil(ch->baremetalWaiters, doorbell, [&] {
+            return (n = ch->linux2baremetal.pop(msgs, 32)) > 0;
+        }))
+            ;
+        for (size_t i = 0; i < n; ++i)
+            if (msgs[i].id == MessageChannel::STOP)
+                return;
+        size_t pushed = 0;
+        spinUntil([&] {
+            pushed += ch->baremetal2linux.push(msgs + pushed, n - pushed);
+            return pushed == n;
+        });
+    }
+}
+
+/// Publish telemetry as fast as possible until Linux is done reading.
+void publish(volatile TelemetryStruct *tl, volatile TestStruct *sm) {
+    for (uint32_t i = 0; sm->ack.load(std::memory_order_relaxed) != Stop; ++i) {
+        Telemetry t;
+        t.iteration = i;
+        t.counter   = sm->getCounter();
+        for (uint32_t k = 0; k < 8; ++k)
+            t.samples[k] = i + k;
+        tl->telemetry.write(t);
+    }
+}
+
+/// Serve remote procedure calls until RpcStop is received.
+void serve(volatile RpcStruct *rpc) {
+    bool serving = true;
+    auto handler = [&](const RpcRequest &req, RpcResponse &resp) {
+        return rpcDispatch<RpcAdd>(req, resp,
+                                   [](auto r) { return r.a + r.b; }) ||
+               rpcDispatch<RpcStop>(req, resp, [&](auto) {
+                   serving = false;
+                   return RpcStop::Response{};
+               });
+    };
+    while (serving)
+        spinUntil([&] { return rpcServe(&rpc->channel, handler) > 0; });
+}
+
+/// Pick up the latest control frames until the last one, and check that none
+/// of them are torn or out of order.
+void readControl(volatile ControlStruct *ctl, volatile TestStruct *sm) {
+    uint32_t seen = 0, previous = 0;
+    while (true) {
+        spinUntil([&] { return ctl->frames.update(); });
+        const ControlFrame &f = ctl->frames.front();
+        bool last             = f.cycle == ~0u;
+        if (ctl->frames.sequence() <= previous ||
+            (!last && f.cycle != ctl->frames.sequence() - 1))
+            throw std::runtime_error("triple buffer: out of order");
+        for (uint32_t k = 0; k < 255; ++k)
+            if (f.setpoints[k] != f.cycle + k)
+                throw std::runtime_error("triple buffer: torn frame");
+        previous = ctl->frames.sequence();
+        ++seen;
+        if (last)
+            break;
+    }
+    sm->testBaremetal2Linux.store(seen, std::memory_order_relaxed);
+    sm->ack.store(Reply, std::memory_order_release);
+}
+
+/// Poll the parameters until the last batch, and check that every batch is
+/// seen as a whole.
+void readParameters(volatile ParameterStruct *par, volatile TestStruct *sm) {
+    using Store      = decltype(par->parameters);
+    uint32_t version = 0, seen = 0, previous = 0;
+    ParameterChange changes[Store::CAPACITY];
+    while (true) {
+        size_t count;
+        spinUntil([&] {
+            return (count = par->parameters.changedSince(version, changes));
+        });
+        uint32_t values[5] = {};
+        for (size_t i = 0; i < count; ++i)
+            values[changes[i].key] = changes[i].value;
+        uint32_t batch = values[PARAM_LIMIT];
+        if (count != 4 || values[PARAM_MODE] != batch ||
+            Store::decode<float>(values[PARAM_GAIN]) != float(batch) ||
+            Store::decode<float>(values[PARAM_OFFSET]) != -float(batch))
+            throw std::runtime_error("parameters: torn batch");
+        if (batch <= previous)
+            throw std::runtime_error("parameters: out of order");
+        previous = batch;
+        ++seen;
+        if (batch == ~0u)
+            break;
+    }
+    size_t limit = par->parameters.indexOf(PARAM_LIMIT);
+    if (limit == Store::CAPACITY || par->parameters.get(limit) != ~0u)
+        throw std::runtime_error("parameters: lookup failed");
+    sm->testBaremetal2Linux.store(seen, std::memory_order_relaxed);
+    sm->ack.store(Done, std::memory_order_release);
+}
+
+/// Fill frames in place and send their descriptors to Linux.
+void produceFrames(volatile FrameExchange *fx, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t index;
+        spinUntil([&] {
+            return (index = fx->pool.allocate()) != fx->pool.NIL;
+        });
+        auto *data = reinterpret_cast<uint32_t *>(fx->pool.data(index));
+        for (uint32_t k = 0; k < fx->pool.blockSize() / 4; ++k)
+            data[k] = i + k;
+        BufferDescriptor desc = {index, uint32_t(fx->pool.blockSize())};
+        spinUntil([&] { return fx->baremetal2linux.push(desc); });
+    }
+}
+
+/// Construct a shared struct at its address in the mapping, like initShared
+/// does on Baremetal.
+template <class T>
+volatile T *initShared(SharedMemReferenceCounter &shm) {
+    return initAt<T>(shm.getAddress(sharedAddress<T>));
+}
+
+/// Does the same as the bare-metal side of sharedmem.cpp.
+void baremetal(SharedMemReferenceCounter &shm, EventfdDoorbell &linuxDoorbell,
+               EventfdDoorbell &baremetalDoorbell, size_t increments,
+               uint32_t counts, uint32_t frames) {
+    auto *fx  = initShared<FrameExchange>(shm);
+    auto *tl  = initShared<TelemetryStruct>(shm);
+    auto *ch  = initShared<MessageChannel>(shm);
+    auto *sm  = initShared<TestStruct>(shm);
+    auto *tr  = initShared<TraceStruct>(shm);
+    auto *rpc = initShared<RpcStruct>(shm);
+    auto *ctl = initShared<ControlStruct>(shm);
+    auto *par = initShared<ParameterStruct>(shm);
+    auto *cnt = initShared<CounterStruct>(shm);
+
+    while (true) {
+        uint32_t ack;
+        waitUntil(sm->baremetalWaiters, baremetalDoorbell,
+                  [&] {
+                      ack = sm->ack.load(std::memory_order_acquire);
+                      return ack == Request || ack == Go;
+                  });
+        if (ack == Go)
+            break;
+        uint32_t value =
+            sm->testLinux2Baremetal.load(std::memory_order_relaxed);
+        sm->testBaremetal2Linux.store(~value, std::memory_order_relaxed);
+        sm->ack.store(Reply, std::memory_order_release);
+        notify(sm->linuxWaiters, linuxDoorbell);
+    }
+
+    for (size_t i = 0; i < increments; ++i)
+        sm->increment(BAREMETAL_CORE);
+    sm->ack.store(Done, std::memory_order_release);
+    countAll(cnt, BAREMETAL_CORE, counts);
+
+    echo(ch, baremetalDoorbell);
+    produceFrames(fx, frames);
+    publish(tl, sm);
+    serve(rpc);
+    readControl(ctl, sm);
+    readParameters(par, sm);
+    tr->trace(TRACE_STOP, 0, 0, BAREMETAL_CORE);
+}
+
+// ================================= LINUX ================================== //
+
+void printStats(const char *name, std::vector<double> &ns, double seconds) {
+    std::sort(ns.begin(), ns.end());
+    auto pct = [&](double p) { return ns[size_t(p * (ns.size() - 1))]; };
+    std::cout << std::setw(10) << name << ": " << std::setw(12)
+              << ns.size() / seconds << " msg/s, p50 = " << pct(0.5)
+              << " ns, p90 = " << pct(0.9) << " ns, p99 = " << pct(0.99)
+              << " ns, p99.9 = " << pct(0.999) << " ns, max = " << ns.back()
+              << " ns" << std::endl;
+}
+
+/// Time a single call to the given function.
+template <class F>
+double timeNs(F f) {
+    auto start = clk::now();
+    f();
+    return std::chrono::duration<double, std::nano>(clk::now() - start).count();
+}
+
+/// The ack-flag handshake: write a value, wait for the reply.
+void benchHandshake(volatile TestStruct *sm, EventfdDoorbell &linuxDoorbell,
+                    EventfdDoorbell &baremetalDoorbell, uint32_t count) {
+    std::vector<double> ns;
+    ns.reserve(count);
+    auto start = clk::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        ns.push_back(timeNs([&] {
+            sm->testLinux2Baremetal.store(i, std::memory_order_relaxed);
+            sm->ack.store(Request, std::memory_order_release);
+            notify(sm->baremetalWaiters, baremetalDoorbell);
+            waitUntil(sm->linuxWaiters, linuxDoorbell, [&] {
+                return sm->ack.load(std::memory_order_acquire) == Reply;
+            });
+        }));
+        if (sm->testBaremetal2Linux.load(std::memory_order_relaxed) != ~i)
+            throw std::runtime_error("handshake: wrong reply");
+    }
+    std::chrono::duration<double> duration = clk::now() - start;
+    printStats("handshake", ns, duration.count());
+}
+
+/// Both sides call TestStruct::increment at the same time.
+void benchIncrement(volatile TestStruct *sm, EventfdDoorbell &baremetalDoorbell,
+                    uint32_t count) {
+    std::vector<double> ns;
+    ns.reserve(count);
+    sm->ack.store(Go, std::memory_order_release);
+    notify(sm->baremetalWaiters, baremetalDoorbell);
+    auto start = clk::now();
+    for (uint32_t i = 0; i < count; ++i)
+        ns.push_back(timeNs([&] { sm->increment(); }));
+    std::chrono::duration<double> duration = clk::now() - start;
+    spinUntil([&] { return sm->ack.load(std::memory_order_acquire) == Done; });
+    printStats("increment", ns, duration.count());
+    uint32_t result = sm->getCounter();
+    std::cout << std::setw(10) << "" << "  counter = " << result << " ("
+              << 2 * count - result << " lost updates)" << std::endl;
+}
+
+/// Both sides update a counter under a lock, with an atomic fetch-add, and
+/// in their own slot of a sharded counter.
+void benchCounters(volatile CounterStruct *cnt, uint32_t count) {
+    std::array<double, 3> ns = countAll(cnt, LINUX_CORE, count);
+    uint32_t results[3]      = {cnt->locked, cnt->atomic.get(),
+                                cnt->sharded.get()};
+    const char *names[3]     = {"locked", "atomic", "sharded"};
+    for (size_t i = 0; i < 3; ++i)
+        std::cout << std::setw(10) << names[i] << ": " << std::setw(12)
+                  << 1e9 / ns[i] << " adds/s, " << ns[i] << " ns/add, "
+                  << 2 * count - results[i] << " lost updates" << std::endl;
+    LockStats stats = cnt->lock.getStats();
+    std::cout << std::setw(10) << "" << "  " << stats.contended
+              << " contended acquisitions, longest wait " << stats.maxWaitUs
+              << " µs" << std::endl;
+}
+
+/// Round-trip latency of the message rings: send one message and wait for its
+/// echo.
+void benchRingLatency(volatile MessageChannel *ch, EventfdDoorbell &doorbell,
+                      uint32_t count) {
+    std::vector<double> ns;
+    ns.reserve(count);
+    auto start = clk::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        Message msg;
+        ns.push_back(timeNs([&] {
+            spinUntil([&] { return ch->linux2baremetal.push(Message{i, ~i}); });
+            notify(ch->baremetalWaiters, doorbell);
+            spinUntil([&] { return ch->baremetal2linux.pop(msg); });
+        }));
+        if (msg.id != i || msg.value != ~i)
+            throw std::runtime_error("ring latency: wrong reply");
+    }
+    std::chrono::duration<double> duration = clk::now() - start;
+    printStats("ring", ns, duration.count());
+}
+
+/// Throughput of the message rings: keep the request ring full and drain the
+/// replies.
+void benchRingThroughput(volatile MessageChannel *ch,
+                         EventfdDoorbell &doorbell, uint32_t count) {
+    Message msgs[32];
+    uint32_t sent = 0, received = 0;
+    auto start    = clk::now();
+    while (received < count) {
+        size_t n = 0;
+        for (; n < 32 && sent + n < count; ++n)
+            msgs[n] = {sent + uint32_t(n), ~(sent + uint32_t(n))};
+        size_t pushed = ch->linux2baremetal.push(msgs, n);
+        if (pushed > 0)
+            notify(ch->baremetalWaiters, doorbell);
+        sent += pushed;
+        size_t r = ch->baremetal2linux.pop(msgs, 32);
+        for (size_t i = 0; i < r; ++i, ++received)
+            if (msgs[i].id != received)
+                throw std::runtime_error("ring throughput: wrong reply");
+        if (r == 0)
+            sched_yield();
+    }
+    std::chrono::duration<double> duration = clk::now() - start;
+    std::cout << std::setw(10) << "ring" << ": " << std::setw(12)
+              << count / duration.count() << " msg/s (streaming)" << std::endl;
+}
+
+/// Many threads send messages through one multiplexer, each keeping a window
+/// of messages in flight.
+void benchMultiplexer(volatile MessageChannel *ch, EventfdDoorbell &doorbell,
+                      uint32_t threads, uint32_t count) {
+    constexpr uint32_t WINDOW = 16;
+    MessageMultiplexer<EventfdDoorbell> mux(ch, doorbell);
+    std::vector<std::thread> senders;
+    std::atomic<bool> ok = {true};
+    auto start           = clk::now();
+    for (uint32_t t = 0; t < threads; ++t) {
+        senders.emplace_back([&, t] {
+            std::future<uint32_t> window[WINDOW];
+            for (uint32_t i = 0; i < count + WINDOW; ++i) {
+                auto &f = window[i % WINDOW];
+                if (i >= WINDOW && f.get() != (t << 24 | (i - WINDOW)))
+                    ok = false;
+                if (i < count)
+                    f = mux.send(t << 24 | i);
+            }
+        });
+    }
+    for (auto &sender : senders)
+        sender.join();
+    std::chrono::duration<double> duration = clk::now() - start;
+    if (!ok)
+        throw std::runtime_error("multiplexer: reply sent to wrong thread");
+    auto stats = mux.getStats();
+    std::cout << std::setw(10) << "mux" << ": " << std::setw(12)
+              << stats.messages / duration.count() << " msg/s, " << threads
+              << " threads, " << double(stats.messages) / stats.batches
+              << " messages per batch" << std::endl;
+
+    // Give the echo loop time to park on the doorbell, the notification of
+    // the multiplexer has to wake it up again
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto reply = mux.send(0xC0FFEE);
+    if (reply.wait_for(std::chrono::seconds(1)) != std::future_status::ready ||
+        reply.get() != 0xC0FFEE)
+        throw std::runtime_error("multiplexer: Baremetal was not woken up");
+}
+
+/// Round trips through a poller that services several endpoints, with the
+/// sender blocked until the poller sees the reply.
+void benchReactor(volatile MessageChannel *ch,
+                  EventfdDoorbell &baremetalDoorbell, volatile TestStruct *sm,
+                  volatile TraceStruct *tr, volatile ParameterStruct *par,
+                  uint32_t count) {
+    SleepDoorbell doorbell;
+    PollReactor<SleepDoorbell> reactor(doorbell);
+    uint32_t received = 0;
+    reactor.addRing("replies", ch->baremetal2linux, [&](const Message &msg) {
+        if (msg.id != received++)
+            throw std::runtime_error("reactor: out of order");
+    });
+    // Idle endpoints, polled on every pass as well
+    auto ignore = [](uint32_t) {};
+    reactor.addChange(
+        "ack", [sm] { return sm->ack.load(std::memory_order_acquire); },
+        ignore);
+    reactor.addChange(
+        "params", [par] { return par->parameters.getVersion(); }, ignore);
+    reactor.addChange(
+        "trace",
+        [tr] { return tr->rings[BAREMETAL_CORE].recorded(); }, ignore);
+    reactor.start();
+
+    std::vector<double> ns;
+    ns.reserve(count);
+    auto start = clk::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        ns.push_back(timeNs([&] {
+            spinUntil([&] { return ch->linux2baremetal.push(Message{i, 0}); });
+            notify(ch->baremetalWaiters, baremetalDoorbell);
+            reactor.wait([&] { return received > i; });
+        }));
+    }
+    std::chrono::duration<double> duration = clk::now() - start;
+    reactor.stop();
+    printStats("reactor", ns, duration.count());
+    for (size_t e = 0; e < reactor.size(); ++e) {
+        EndpointStats s = reactor.getStats(e);
+        std::cout << std::setw(10) << "" << "  " << std::setw(7) << s.name
+                  << ": " << s.polls << " polls, " << s.active
+                  << " active, " << s.events << " events, "
+                  << (s.active ? s.busyNs / s.active : 0) << " ns/active poll"
+                  << " (max " << s.maxNs << " ns)" << std::endl;
+    }
+    std::cout << std::setw(10) << "" << "  " << reactor.getPasses()
+              << " passes, " << reactor.getParked() << " parked" << std::endl;
+}
+
+/// Receive frames by descriptor, check them and give them back to the pool.
+void benchFrames(volatile FrameExchange *fx, uint32_t count) {
+    auto start = clk::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        BufferDescriptor desc;
+        spinUntil([&] { return fx->baremetal2linux.pop(desc); });
+        auto *data =
+            reinterpret_cast<const uint32_t *>(fx->pool.data(desc.index));
+        for (uint32_t k = 0; k < desc.length / 4; ++k)
+            if (data[k] != i + k)
+                throw std::runtime_error("frames: wrong data");
+        fx->pool.release(desc.index);
+    }
+    std::chrono::duration<double> duration = clk::now() - start;
+    double rate = count / duration.count();
+    std::cout << std::setw(10) << "frames" << ": " << std::setw(12) << rate
+              << " frames/s, " << rate * fx->pool.blockSize() / 1e6
+              << " MB/s (zero-copy)" << std::endl;
+}
+
+/// Read telemetry snapshots while the writer is publishing.
+void benchSeqlock(volatile TelemetryStruct *tl, volatile TestStruct *sm,
+                  uint32_t count) {
+    std::vector<double> ns;
+    ns.reserve(count);
+    spinUntil([&] { return tl->telemetry.version() > 0; });
+    uint32_t retries = 0;
+    auto start       = clk::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        Telemetry t;
+        ns.push_back(timeNs([&] {
+            while (!tl->telemetry.tryRead(t))
+                ++retries;
+        }));
+        for (uint32_t k = 0; k < 8; ++k)
+            if (t.samples[k] != t.iteration + k)
+                throw std::runtime_error("seqlock: torn read");
+    }
+    std::chrono::duration<double> duration = clk::now() - start;
+    sm->ack.store(Stop, std::memory_order_relaxed);
+    printStats("seqlock", ns, duration.count());
+    std::cout << std::setw(10) << "" << "  " << retries << " retries, "
+              << tl->telemetry.version() << " snapshots published"
+              << std::endl;
+}
+
+/// Publish control frames as fast as possible, filled in place. The reader
+/// picks up the latest one whenever it's ready.
+void benchTripleBuffer(volatile ControlStruct *ctl, volatile TestStruct *sm,
+                       uint32_t count) {
+    auto start = clk::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        ControlFrame &f = ctl->frames.back();
+        f.cycle         = i + 1 == count ? ~0u : i;
+        for (uint32_t k = 0; k < 255; ++k)
+            f.setpoints[k] = f.cycle + k;
+        ctl->frames.publish();
+    }
+    std::chrono::duration<double> duration = clk::now() - start;
+    spinUntil([&] { return sm->ack.load(std::memory_order_acquire) == Reply; });
+    uint32_t seen = sm->testBaremetal2Linux.load(std::memory_order_relaxed);
+    std::cout << std::setw(10) << "triple" << ": " << std::setw(12)
+              << count / duration.count() << " frames/s, "
+              << count / duration.count() * sizeof(ControlFrame) / 1e6
+              << " MB/s, " << seen << " picked up by the reader" << std::endl;
+}
+
+/// Update a batch of related parameters as fast as possible, while the reader
+/// polls for changes.
+void benchParameters(volatile ParameterStruct *par, volatile TestStruct *sm,
+                     uint32_t count) {
+    using Store = decltype(par->parameters);
+    auto start  = clk::now();
+    for (uint32_t i = 1; i <= count; ++i) {
+        uint32_t batch            = i == count ? ~0u : i;
+        ParameterUpdate update[4] = {
+            {PARAM_GAIN, Store::encode(float(batch))},
+            {PARAM_OFFSET, Store::encode(-float(batch))},
+            {PARAM_LIMIT, batch},
+            {PARAM_MODE, batch},
+        };
+        if (!par->parameters.update(update, 4))
+            throw std::runtime_error("parameters: update rejected");
+    }
+    std::chrono::duration<double> duration = clk::now() - start;
+    spinUntil([&] { return sm->ack.load(std::memory_order_acquire) == Done; });
+    uint32_t seen = sm->testBaremetal2Linux.load(std::memory_order_relaxed);
+    std::cout << std::setw(10) << "params" << ": " << std::setw(12)
+              << count / duration.count() << " batches/s, " << seen
+              << " picked up by the reader" << std::endl;
+}
+
+#if __cpp_impl_coroutine
+RpcTask addAll(RpcClient<16> &client, uint32_t first, uint32_t count,
+               uint64_t &sum) {
+    for (uint32_t i = 0; i < count; ++i)
+        sum += co_await client.call<RpcAdd>({first, i});
+}
+
+RpcTask stop(RpcClient<16> &client) { co_await client.call<RpcStop>({}); }
+
+/// Poll the client until all tasks are done.
+void run(RpcClient<16> &client, std::vector<RpcTask> &tasks) {
+    for (auto &task : tasks) {
+        spinUntil([&] { return client.poll(), task.done(); });
+        task.get();
+    }
+}
+
+/// Throughput of remote procedure calls, one at a time, and with many in
+/// flight from concurrent coroutines.
+void benchRpc(volatile RpcStruct *rpc, uint32_t count) {
+    RpcClient<16> client(&rpc->channel);
+    for (uint32_t depth : {1, 4, 16}) {
+        uint32_t perTask = count / depth;
+        uint64_t sum     = 0;
+        std::vector<RpcTask> tasks;
+        auto start = clk::now();
+        for (uint32_t t = 0; t < depth; ++t)
+            tasks.push_back(addAll(client, t, perTask, sum));
+        run(client, tasks);
+        std::chrono::duration<double> duration = clk::now() - start;
+        uint64_t n = uint64_t(depth) * perTask;
+        if (sum != n * (perTask - 1) / 2 + n * (depth - 1) / 2)
+            throw std::runtime_error("rpc: wrong sum");
+        std::cout << std::setw(10) << "rpc" << ": " << std::setw(12)
+                  << n / duration.count() << " calls/s (" << depth
+                  << " in flight)" << std::endl;
+    }
+    std::vector<RpcTask> tasks;
+    tasks.push_back(stop(client));
+    run(client, tasks);
+}
+#else
+/// RpcClient needs C++20 coroutines, only stop the dispatch loop.
+void benchRpc(volatile RpcStruct *rpc, uint32_t) {
+    spinUntil([&] {
+        return rpc->channel.requests.push(RpcRequest{0, RpcStop::ID, 0, {}});
+    });
+}
+#endif
+
+/// Read and update a struct with many fields, one field at a time, and in
+/// bursts with snapshot and commit.
+void benchSettings(BaremetalShared<SettingsStruct> &settings, uint32_t count) {
+    volatile SettingsStruct *s = settings.ptr();
+    SettingsStruct local       = settings.snapshot();
+    auto start                 = clk::now();
+    for (uint32_t i = 0; i < count; ++i) {
+        local.sampleRate = s->sampleRate;
+        local.decimation = s->decimation;
+        for (size_t k = 0; k < 16; ++k) {
+            local.gains[k]      = s->gains[k];
+            local.offsets[k]    = s->offsets[k];
+            local.thresholds[k] = s->thresholds[k];
+        }
+        local.flags = s->flags;
+    }
+    std::chrono::duration<double> fields = clk::now() - start;
+
+    start = clk::now();
+    for (uint32_t i = 0; i < count; ++i)
+        local = settings.snapshot();
+    std::chrono::duration<double> bursts = clk::now() - start;
+
+    SettingsStruct changed = local;
+    changed.sampleRate     = local.sampleRate + 1;
+    changed.gains[7]       = local.gains[7] + 1;
+    size_t written         = settings.commit(changed, local);
+    SettingsStruct check   = settings.snapshot();
+    if (check.sampleRate != changed.sampleRate ||
+        check.gains[7] != changed.gains[7] || check.flags != local.flags)
+        throw std::runtime_error("settings: commit failed");
+
+    std::cout << std::setw(10) << "settings" << ": " << std::setw(12)
+              << fields.count() * 1e9 / count << " ns per read (51 fields), "
+              << bursts.count() * 1e9 / count << " ns per snapshot ("
+              << (sizeof(SettingsStruct) + BURST_SIZE - 1) / BURST_SIZE
+              << " bursts), " << written << " bursts to commit 2 fields"
+              << std::endl;
+}
+
+/// Cost of recording trace events, with and without reading the clock, and
+/// check that the latest ones can be decoded.
+void benchTrace(volatile TraceStruct *tr, uint32_t count) {
+    auto &ring     = tr->rings[LINUX_CORE];
+    uint64_t ticks = timestampTicks();
+    auto start     = clk::now();
+    for (uint32_t i = 0; i < count; ++i)
+        tr->traceAt(ticks, TRACE_MESSAGE_SENT, i, ~i);
+    std::chrono::duration<double> untimed = clk::now() - start;
+    start = clk::now();
+    for (uint32_t i = count; i < 2 * count; ++i)
+        tr->trace(TRACE_MESSAGE_SENT, i, ~i);
+    std::chrono::duration<double> timed = clk::now() - start;
+
+    std::vector<TraceRecord> records(ring.CAPACITY);
+    records.resize(ring.read(records.data()));
+    for (uint32_t i = 0; i < records.size(); ++i) {
+        auto &r        = records[i];
+        uint32_t index = 2 * count - records.size() + i;
+        if (r.sequence != index || r.arg0 != index || r.arg1 != ~index ||
+            r.core != LINUX_CORE || r.event != TRACE_MESSAGE_SENT)
+            throw std::runtime_error("trace: corrupt event");
+    }
+    std::cout << std::setw(10) << "trace" << ": " << std::setw(12)
+              << count / timed.count() << " events/s, "
+              << timed.count() * 1e9 / count << " ns/event, "
+              << untimed.count() * 1e9 / count
+              << " ns/event with the caller's timestamp, " << records.size()
+              << " decoded" << std::endl;
+}
+
+/// Cache maintenance that Baremetal needs per control cycle if the shared
+/// memory is cacheable: invalidate the control frame it receives, and clean
+/// the telemetry it sends. Counted by eagle_cache_sim.cpp.
+void benchCachePolicies(uint32_t count) {
+    // The same structs in the OCM, and in write-back DDR behind the L2 cache
+    constexpr uintptr_t DDR_OFFSET = 0x3F000000 - SHARED_MEM_START_ADDRESS;
+    for (uintptr_t offset : {uintptr_t(0), DDR_OFFSET}) {
+        EagleCacheOp ops[2] = {
+            {sharedAddress<ControlStruct> + offset, sizeof(ControlFrame),
+             EAGLE_INVALIDATE},
+            {sharedAddress<TelemetryStruct> + offset, sizeof(Telemetry),
+             EAGLE_CLEAN},
+        };
+        struct Policy {
+            const char *name;
+            void (*maintain)(const EagleCacheOp *batch);
+        };
+        const Policy policies[] = {
+            {"full", [](const EagleCacheOp *) { eagle_DCacheFlush(); }},
+            {"ranged",
+             [](const EagleCacheOp *batch) {
+                 eagle_DCacheInvalidateRange(batch[0].address, batch[0].size);
+                 eagle_DCacheCleanRange(batch[1].address, batch[1].size);
+             }},
+            {"batched",
+             [](const EagleCacheOp *batch) { eagle_DCacheMaintain(batch, 2); }},
+        };
+        for (const Policy &policy : policies) {
+            eagle_ResetCacheStats();
+            for (uint32_t i = 0; i < count; ++i)
+                policy.maintain(ops);
+            EagleCacheStats s = eagle_GetCacheStats();
+            uint32_t lines = s.lineCleans + s.lineInvalidates + s.lineFlushes;
+            std::cout << std::setw(10) << "cache" << ": " << std::setw(7)
+                      << policy.name << " (" << (offset ? "DDR" : "OCM")
+                      << "), per cycle: " << double(lines) / count
+                      << " L1 lines, " << double(s.l2Lines) / count
+                      << " L2 lines, " << double(s.barriers) / count
+                      << " barriers" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    constexpr uint32_t NUM_HANDSHAKES = 100'000;
+    constexpr uint32_t NUM_INCREMENTS = 1'000;
+    constexpr uint32_t NUM_COUNTS     = 100'000;
+    constexpr uint32_t NUM_MESSAGES   = 1'000'000;
+    constexpr uint32_t NUM_FRAMES     = 100'000;
+
+    std::string backend = argc > 1 ? argv[1] : "memfd";
+    std::string name    = argc > 2 ? argv[2] : "";
+    if (backend == "memfd")
+        SharedMemReferenceCounter::setBackend(SharedMemBackend::Memfd);
+    else if (backend == "shm")
+        SharedMemReferenceCounter::setBackend(
+            SharedMemBackend::SharedMemoryObject,
+            name.empty() ? "/ipc_bench" : name);
+    else if (backend == "file")
+        SharedMemReferenceCounter::setBackend(
+            SharedMemBackend::File, name.empty() ? "ipc_bench.mem" : name);
+    else if (backend == "devmem")
+        SharedMemReferenceCounter::setBackend(SharedMemBackend::DevMem);
+    else {
+        std::cerr << "Usage: " << argv[0]
+                  << " [memfd | shm <name> | file <path> | devmem]"
+                  << std::endl;
+        return 1;
+    }
+
+    EventfdDoorbell linuxDoorbell, baremetalDoorbell;
+    BaremetalShared<TestStruct> sm;  // Maps the memory before forking
+    BaremetalShared<MessageChannel> ch;
+    BaremetalShared<TelemetryStruct> tl;
+    BaremetalShared<FrameExchange> fx;
+    BaremetalShared<TraceStruct> tr;
+    BaremetalShared<RpcStruct> rpc;
+    BaremetalShared<ControlStruct> ctl;
+    BaremetalShared<SettingsStruct> settings;
+    BaremetalShared<ParameterStruct> par;
+    BaremetalShared<CounterStruct> cnt;
+    sm->magic.store(0, std::memory_order_relaxed);
+
+    pid_t pid = fork();
+    if (pid < 0)
+        throw std::runtime_error("fork failed");
+    if (pid == 0) {
+        SharedMemReferenceCounter shm;
+        baremetal(shm, linuxDoorbell, baremetalDoorbell, NUM_INCREMENTS,
+                  NUM_COUNTS, NUM_FRAMES);
+        _exit(0);
+    }
+
+    // Wait for the "baremetal" process to initialize the shared memory
+    spinUntil([&] {
+        return sm->magic.load(std::memory_order_acquire) == TestStruct::MAGIC;
+    });
+
+    benchHandshake(sm.ptr(), linuxDoorbell, baremetalDoorbell, NUM_HANDSHAKES);
+    benchIncrement(sm.ptr(), baremetalDoorbell, NUM_INCREMENTS);
+    benchCounters(cnt.ptr(), NUM_COUNTS);
+    benchRingLatency(ch.ptr(), baremetalDoorbell, NUM_HANDSHAKES);
+    benchRingThroughput(ch.ptr(), baremetalDoorbell, NUM_MESSAGES);
+    benchMultiplexer(ch.ptr(), baremetalDoorbell, 4, NUM_HANDSHAKES);
+    benchReactor(ch.ptr(), baremetalDoorbell, sm.ptr(), tr.ptr(), par.ptr(),
+                 NUM_HANDSHAKES / 10);
+
+    spinUntil([&] {
+        return ch->linux2baremetal.push(Message{MessageChannel::STOP, 0});
+    });
+    notify(ch->baremetalWaiters, baremetalDoorbell);
+    benchFrames(fx.ptr(), NUM_FRAMES);
+    benchSeqlock(tl.ptr(), sm.ptr(), NUM_HANDSHAKES);
+    benchRpc(rpc.ptr(), NUM_HANDSHAKES);
+    benchTripleBuffer(ctl.ptr(), sm.ptr(), NUM_FRAMES);
+    benchParameters(par.ptr(), sm.ptr(), NUM_FRAMES);
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        throw std::runtime_error("baremetal process failed");
+    benchTrace(tr.ptr(), NUM_MESSAGES);
+    benchSettings(settings, NUM_MESSAGES);
+    benchCachePolicies(NUM_HANDSHAKES);
+    if (backend == "shm")
+        shm_unlink(name.empty() ? "/ipc_bench" : name.c_str());
+}
@@ -0,0 +1,34 @@
+// Prints the latency histograms that both cores record in the shared memory,
+// for every interval and in total, while sharedmem.cpp is running.
+//
+// Usage: latency_monitor [interval in seconds]
+
+#include <SharedMem.hpp>      // BaremetalShared
+#include <SharedStructs.hpp>  // LatencyStruct
+
+#include <cstdlib>   // atof
+#include <iostream>  // cout
+#include <unistd.h>  // usleep
+
+int main(int argc, char *argv[]) {
+    double interval = argc > 1 ? std::atof(argv[1]) : 1.0;
+    const char *names[NUM_CORES] = {"Linux", "Baremetal"};
+
+    BaremetalShared<LatencyStruct> latency;
+    LatencyHistogram<>::Snapshot previous[NUM_CORES];
+    for (size_t core = 0; core < NUM_CORES; ++core)
+        previous[core] = latency->histograms[core].snapshot();
+
+    while (true) {
+        usleep(interval * 1e6);
+        for (size_t core = 0; core < NUM_CORES; ++core) {
+            auto current = latency->histograms[core].snapshot();
+            std::cout << names[core] << std::endl;
+            auto window = current.since(previous[core]);
+            printLatencies(std::cout, "interval", window);
+            printLatencies(std::cout, "total", current);
+            previous[core] = current;
+        }
+        std::cout << std::endl;
+    }
+}
@@ -1,120 +1,142 @@
-#include <atomic>     // atomic_flag
-#include <cassert>    // assert
-#include <cstdint>    // uint32_t
-#include <iostream>   // cout
-#include <stdexcept>  // runtime_error
-#ifdef BAREMETAL
-#include <ps7_cortexa9_1/include/sleep.h>
-#else
-#include <unistd.h>
-#endif
-
-// ================================== LOCK ================================== //
-
-class ScopedLock {
-  public:
-    ScopedLock(volatile std::atomic_flag &lock) : lock{lock} {
-        bool locked = true;
-        for (size_t i = 0; i < NUM_RETRIES; ++i) {
-            locked = lock.test_and_set(std::memory_order_acquire);
-            std::cout << "locked = " << locked << std::endl;
-            if (locked)
-                usleep(WAIT_TIME);
-            else
-                break;
-        }
-        if (locked)
-            throw std::runtime_error("Timeout: Could not acquire lock");
-    }
-
-    ~ScopedLock() {
-        lock.clear(std::memory_order_release);
-        std::cout << "released" << std::endl;
-    }
-
-  private:
-    volatile std::atomic_flag &lock;
-    constexpr static size_t NUM_RETRIES   = 10;
-    constexpr static useconds_t WAIT_TIME = 50;
-};
-
-constexpr uintptr_t SHARED_MEM_START_ADDRESS = 0xFFFF0000;
-constexpr uintptr_t SHARED_MEM_LAST_ADDRESS  = 0xFFFFFFFF;
-
-// ============================== TEST STRUCT =============================== //
-
-#define atomic_flag32 std::atomic_flag __attribute__((aligned(4)))
+#include <CpuUtils.hpp>       // timestampTicks
+#include <SharedStructs.hpp>  // TestStruct, MessageChannel, LatencyStruct,
+                              // TraceStruct, RpcStruct
 
-struct TestStruct {
-  private:
-    mutable atomic_flag32 test_lock = ATOMIC_FLAG_INIT;
-    uint32_t counter                = 0;
+#include <cassert>   // assert
+#include <cstdint>   // uint32_t
+#include <iostream>  // cout
+#include <vector>    // vector
 
-  public:
-    uint32_t ack = 0;
-    uint32_t testBaremetal2Linux;
-    uint32_t testLinux2Baremetal;
-    uint32_t magic = 0xAA55AA55;
+#ifndef BAREMETAL
+// ================================= LINUX ================================== //
 
-    constexpr static uintptr_t address = SHARED_MEM_START_ADDRESS + 0x2000;
+#include <SharedMem.hpp>  // BaremetalShared
 
-    void increment() volatile {
-        {
-            // ScopedLock lock(test_lock);
-            uint32_t tmp = counter;
-            usleep(40);
-            counter = tmp + 1;
-        }
-        usleep(10);
-    }
+#if __cpp_impl_coroutine
+#include <RpcClient.hpp>  // RpcClient, RpcTask
 
-    uint32_t getCounter() const volatile {
-        // ScopedLock lock(test_lock);
-        return counter;
-    }
+/// Sums the results of many RPCs. Several of these run at the same time, so
+/// there are always multiple requests in flight.
+RpcTask addAll(RpcClient<16> &client, uint32_t first, uint32_t count,
+               uint64_t &sum) {
+    for (uint32_t i = 0; i < count; ++i)
+        sum += co_await client.call<RpcAdd>({first, i});
+}
 
-#ifdef BAREMETAL  // Only Baremetal can initialize the shared memory
-    static volatile TestStruct *init() {
-        static_assert(address >= SHARED_MEM_START_ADDRESS);
-        static_assert(address <= SHARED_MEM_LAST_ADDRESS - sizeof(TestStruct));
-        return new ((void *) address) TestStruct();
-    }
+RpcTask stop(RpcClient<16> &client) { co_await client.call<RpcStop>({}); }
 #endif
 
-  private:
-    TestStruct() = default;
-};
-
-#ifndef BAREMETAL
-// ================================= LINUX ================================== //
-
-#include <SharedMem.hpp>  // BaremetalShared
+/// Wait until Baremetal sets `ack` to the given value, and report every second
+/// that it's still waiting. Returns false if it didn't within the timeout.
+bool waitForAck(volatile TestStruct *sm, SleepDoorbell &doorbell,
+                uint32_t value, uint32_t timeoutSeconds) {
+    auto acked = [&] {
+        return sm->ack.load(std::memory_order_acquire) == value;
+    };
+    WaitConfig config;
+    config.timeoutUs = 1'000'000;
+    for (uint32_t s = 0; s < timeoutSeconds; ++s) {
+        if (waitUntil(sm->linuxWaiters, doorbell, acked, config))
+            return true;
+        std::cout << "Still waiting for Baremetal (ack = "
+                  << sm->ack.load(std::memory_order_relaxed) << ")"
+                  << std::endl;
+    }
+    return false;
+}
 
 int main() {
+    // The interrupt from the bare-metal core is not routed to Linux yet, so
+    // sleep after spinning (use a UioDoorbell once it is).
+    SleepDoorbell linuxDoorbell;
+    SevDoorbell baremetalDoorbell;
+
     BaremetalShared<TestStruct> baremetal;  // Maps the memory using mmap
-    baremetal->testLinux2Baremetal = 0xBEEFDEAD;
-    baremetal->ack                 = 1;
+    BaremetalShared<TraceStruct> tracer;    // Decoded by trace_dump.cpp
+    tracer->rings[LINUX_CORE].setTicksPerSecond(TICKS_PER_SECOND);
+    baremetal->testLinux2Baremetal.store(0xBEEFDEAD, std::memory_order_relaxed);
+    baremetal->ack.store(1, std::memory_order_release);
+    notify(baremetal->baremetalWaiters, baremetalDoorbell);
 
     // Wait for the baremetal application to start
     std::cout << "Waiting for Baremetal" << std::endl;
-    while (baremetal->ack != 2)
-        ;
-    assert(baremetal->testBaremetal2Linux == 0xDEADBEEF);
+    if (!waitForAck(baremetal.ptr(), linuxDoorbell, 2, 60)) {
+        std::cerr << "Baremetal did not reply" << std::endl;
+        return 1;
+    }
+    tracer->trace(TRACE_SYNC, 2);
+    assert(baremetal->testBaremetal2Linux.load(std::memory_order_relaxed) ==
+           0xDEADBEEF);
     std::cout << "testBaremetal2Linux is correct\n";
     std::cout << "Go\n";
 
     // Increment the shared value many times
     for (size_t i = 0; i < 1'000; ++i)
         baremetal->increment();
+    tracer->trace(TRACE_INCREMENT_DONE, 1'000);
 
     std::cout << std::endl << "Waiting for Baremetal to finish" << std::endl;
     // Wait for baremetal to finish
-    while (baremetal->ack != 3)
-        usleep(100);
+    if (!waitForAck(baremetal.ptr(), linuxDoorbell, 3, 10)) {
+        std::cerr << "Baremetal did not finish" << std::endl;
+        return 1;
+    }
+    tracer->trace(TRACE_ACK, 3);
 
     uint32_t result = baremetal->getCounter();
     std::cout << "Result = " << result << std::endl;
     assert(result == 2'000);
+
+    // Stream timestamped messages to Baremetal, which echoes them back
+    BaremetalShared<MessageChannel> channel;
+    BaremetalShared<LatencyStruct> latency;
+    auto &roundTrip = latency->histograms[LINUX_CORE];
+    roundTrip.setTicksPerSecond(TICKS_PER_SECOND);
+    constexpr uint32_t NUM_MESSAGES = 10'000;
+    uint32_t sent = 0, received = 0;
+    while (received < NUM_MESSAGES) {
+        if (sent < NUM_MESSAGES &&
+            channel->linux2baremetal.push(
+                Message{sent, uint32_t(timestampTicks())})) {
+            notify(channel->baremetalWaiters, baremetalDoorbell);
+            tracer->trace(TRACE_MESSAGE_SENT, sent++);
+        }
+        Message msg;
+        if (channel->baremetal2linux.pop(msg)) {
+            tracer->trace(TRACE_MESSAGE_RECEIVED, msg.id);
+            assert(msg.id == received);
+            roundTrip.record(uint32_t(timestampTicks()) - msg.value);
+            ++received;
+        }
+    }
+    while (!channel->linux2baremetal.push(Message{MessageChannel::STOP, 0}))
+        ;
+    notify(channel->baremetalWaiters, baremetalDoorbell);
+    tracer->trace(TRACE_STOP);
+    std::cout << "Echoed " << received << " messages" << std::endl;
+    printLatencies(std::cout, "round trip", roundTrip.snapshot());
+
+    BaremetalShared<RpcStruct> rpc;
+#if __cpp_impl_coroutine
+    // Pipelined remote procedure calls, completed by polling
+    RpcClient<16> client(&rpc->channel);
+    uint64_t sum = 0;
+    std::vector<RpcTask> tasks;
+    for (uint32_t t = 0; t < 8; ++t)
+        tasks.push_back(addAll(client, t * 1'000, 1'000, sum));
+    tasks.push_back(stop(client));
+    for (auto &task : tasks) {
+        while (!task.done())
+            client.poll();
+        task.get();
+    }
+    std::cout << "RPC sum = " << sum << std::endl;
+    assert(sum == 31'996'000);
+#else
+    // Without coroutines, only stop the dispatch loop
+    while (!rpc->channel.requests.push(RpcRequest{0, RpcStop::ID, 0, {}}))
+        ;
+#endif
 }
 
 #else
@@ -126,11 +148,21 @@ int main() {
     eagle_setup_ipc();  // Configure the inter-processor communication
     usleep(1'000);
 
+    SevDoorbell baremetalDoorbell;
+    SleepDoorbell linuxDoorbell;  // Linux polls, see GicDoorbell
+
     while (1) {
         try {
             // Baremetal always starts before Linux
-            volatile TestStruct *sm = TestStruct::init();
-            sm->testBaremetal2Linux = 0xDEADBEEF;
+            volatile LatencyStruct *lt   = initShared<LatencyStruct>();
+            volatile MessageChannel *ch  = initShared<MessageChannel>();
+            volatile TestStruct *sm      = initShared<TestStruct>();
+            volatile TraceStruct *tracer = initShared<TraceStruct>();
+            volatile RpcStruct *rpc      = initShared<RpcStruct>();
+            auto &service = lt->histograms[BAREMETAL_CORE];
+            service.setTicksPerSecond(TICKS_PER_SECOND);
+            sm->testBaremetal2Linux.store(0xDEADBEEF,
+                                          std::memory_order_relaxed);
             std::cout << "TestStruct initialized at " << std::hex
                       << std::showbase << (uintptr_t) sm << std::dec
                       << std::noshowbase << std::endl;
@@ -138,18 +170,65 @@ int main() {
             usleep(20'000'000);
             std::cout << "C++ Baremetal Started" << std::endl
                       << "Waiting for Linux" << std::endl;
-            while (sm->ack != 1)
-                usleep(100);
-            assert(sm->testLinux2Baremetal == 0xBEEFDEAD);
-            std::cout << "testLinux2Baremetal is correct" << std::endl;
-            std::cout << "Sending ack to Linux" << std::endl;
-            sm->ack = 2;
+            // Linux may start much later, keep waiting
+            auto linuxStarted = [&] {
+                return sm->ack.load(std::memory_order_acquire) == 1;
+            };
+            while (!waitUntil(sm->baremetalWaiters, baremetalDoorbell,
+                              linuxStarted))
+                std::cout << "Still waiting for Linux" << std::endl;
+            assert(sm->testLinux2Baremetal.load(std::memory_order_relaxed) ==
+                   0xBEEFDEAD);
+            // From here on, only trace events: printing would change the timing
+            // Linux traces the same sync event when it sees the ack
+            tracer->trace(TRACE_SYNC, 2);
+            sm->ack.store(2, std::memory_order_release);
+            notify(sm->linuxWaiters, linuxDoorbell);
 
             for (size_t i = 0; i < 1'000; ++i)
                 sm->increment();
-            sm->ack = 3;
-
-            std::cout << "Done" << std::endl;
+            tracer->trace(TRACE_INCREMENT_DONE, 1'000);
+            tracer->trace(TRACE_ACK, 3);
+            sm->ack.store(3, std::memory_order_release);
+            notify(sm->linuxWaiters, linuxDoorbell);
+
+            // Echo all messages from Linux until it sends STOP, and record
+            // how long it takes to service each message. Sleeps (wfe) while
+            // Linux isn't sending anything.
+            Message msg;
+            auto received = [&] { return ch->linux2baremetal.pop(msg); };
+            while (true) {
+                if (!waitUntil(ch->baremetalWaiters, baremetalDoorbell,
+                               received))
+                    continue;
+                uint64_t start = timestampTicks();
+                if (msg.id == MessageChannel::STOP)
+                    break;
+                while (!ch->baremetal2linux.push(msg))
+                    ;
+                uint64_t end = timestampTicks();
+                tracer->traceAt(end, TRACE_MESSAGE_ECHOED, msg.id);
+                service.record(uint32_t(end - start));
+            }
+
+            tracer->trace(TRACE_STOP);
+
+            // Serve remote procedure calls until Linux sends RpcStop
+            bool serving = true;
+            auto handler = [&](const RpcRequest &req, RpcResponse &resp) {
+                return rpcDispatch<RpcAdd>(req, resp,
+                                           [](auto r) { return r.a + r.b; }) ||
+                       rpcDispatch<RpcGetCounter>(
+                           req, resp, [&](auto) { return sm->getCounter(); }) ||
+                       rpcDispatch<RpcStop>(req, resp, [&](auto) {
+                           serving = false;
+                           return RpcStop::Response{};
+                       });
+            };
+            uint32_t calls = 0;
+            while (serving)
+                calls += rpcServe(&rpc->channel, handler);
+            tracer->trace(TRACE_RPC_DONE, calls);
         } catch (std::exception &e) {
             std::cout << "Baremetal Exception: " << e.what() << std::endl;
         }
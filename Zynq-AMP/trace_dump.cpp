@@ -0,0 +1,128 @@
+// Decodes the binary event traces that both cores record in the shared memory
+// and merges them into a single timeline, or a JSON file that can be opened in
+// chrome://tracing or Perfetto.
+//
+// The cores use different clocks, they're aligned using the most recent
+// TRACE_SYNC event that both cores recorded. Without one, both are assumed to
+// use the same clock (e.g. ipc_bench.cpp).
+//
+// Usage: trace_dump [--json <file>]
+
+#include <SharedMem.hpp>      // BaremetalShared
+#include <SharedStructs.hpp>  // TraceStruct, traceEventName
+
+#include <algorithm>  // sort
+#include <cstring>    // strcmp
+#include <fstream>    // ofstream
+#include <iomanip>    // setw, setprecision
+#include <iostream>   // cout, cerr
+#include <vector>     // vector
+
+struct Event {
+    double us;  ///< Time since the first event, in microseconds
+    TraceRecord record;
+};
+
+/// Timestamp of the most recent sync event with the given argument.
+static bool findSync(const std::vector<TraceRecord> &records, uint32_t arg,
+                     uint64_t &timestamp) {
+    for (auto it = records.rbegin(); it != records.rend(); ++it) {
+        if (it->event == TRACE_SYNC && it->arg0 == arg) {
+            timestamp = it->timestamp;
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::vector<Event> decode(volatile TraceStruct *tracer) {
+    std::vector<TraceRecord> records[NUM_CORES];
+    double nsPerTick[NUM_CORES];
+    for (size_t core = 0; core < NUM_CORES; ++core) {
+        auto &ring = tracer->rings[core];
+        records[core].resize(ring.CAPACITY);
+        records[core].resize(ring.read(records[core].data()));
+        nsPerTick[core] = 1e9 / ring.getTicksPerSecond();
+    }
+
+    // Offset of each core's clock relative to Linux, in nanoseconds
+    double offset[NUM_CORES] = {};
+    for (auto it = records[LINUX_CORE].rbegin();
+         it != records[LINUX_CORE].rend(); ++it) {
+        uint64_t bm;
+        if (it->event == TRACE_SYNC &&
+            findSync(records[BAREMETAL_CORE], it->arg0, bm)) {
+            offset[BAREMETAL_CORE] = it->timestamp * nsPerTick[LINUX_CORE] -
+                                     bm * nsPerTick[BAREMETAL_CORE];
+            break;
+        }
+    }
+
+    std::vector<Event> events;
+    for (size_t core = 0; core < NUM_CORES; ++core)
+        for (auto &r : records[core])
+            events.push_back(
+                {(r.timestamp * nsPerTick[core] + offset[core]) / 1e3, r});
+    std::sort(events.begin(), events.end(),
+              [](const Event &a, const Event &b) { return a.us < b.us; });
+    if (!events.empty()) {
+        double start = events.front().us;
+        for (auto &e : events)
+            e.us -= start;
+    }
+    return events;
+}
+
+static void printTimeline(std::ostream &os, const std::vector<Event> &events) {
+    const char *names[NUM_CORES] = {"Linux", "Baremetal"};
+    os << std::fixed << std::setprecision(3);
+    for (auto &e : events)
+        os << std::setw(14) << e.us << " µs  " << std::setw(9)
+           << names[e.record.core % NUM_CORES] << "  #" << std::setw(6)
+           << std::left << e.record.sequence << std::right << "  "
+           << traceEventName(e.record.event) << " (" << e.record.arg0 << ", "
+           << e.record.arg1 << ")\n";
+}
+
+/// Chrome trace event format: one instant event per record, one thread per
+/// core.
+static void printJson(std::ostream &os, const std::vector<Event> &events) {
+    const char *names[NUM_CORES] = {"Linux", "Baremetal"};
+    os << std::fixed << std::setprecision(3) << "{\"traceEvents\": [\n";
+    for (size_t core = 0; core < NUM_CORES; ++core)
+        os << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+           << "\"tid\": " << core << ", \"args\": {\"name\": \""
+           << names[core] << "\"}},\n";
+    for (size_t i = 0; i < events.size(); ++i) {
+        auto &r = events[i].record;
+        os << "  {\"name\": \"" << traceEventName(r.event)
+           << "\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 0, \"tid\": "
+           << r.core << ", \"ts\": " << events[i].us
+           << ", \"args\": {\"arg0\": " << r.arg0 << ", \"arg1\": " << r.arg1
+           << ", \"seq\": " << r.sequence << "}}"
+           << (i + 1 < events.size() ? ",\n" : "\n");
+    }
+    os << "]}\n";
+}
+
+int main(int argc, char *argv[]) {
+    const char *json = nullptr;
+    if (argc == 3 && std::strcmp(argv[1], "--json") == 0) {
+        json = argv[2];
+    } else if (argc != 1) {
+        std::cerr << "Usage: " << argv[0] << " [--json <file>]" << std::endl;
+        return 1;
+    }
+
+    BaremetalShared<TraceStruct> tracer;
+    auto events = decode(tracer.ptr());
+
+    if (json) {
+        std::ofstream file(json);
+        printJson(file, events);
+        std::cout << "Wrote " << events.size() << " events to " << json
+                  << std::endl;
+    } else {
+        printTimeline(std::cout, events);
+    }
+}